@@ -14,3 +14,5 @@ MEMDEBUG = no
 GEOMDEBUG = no
 # disable TRY/CATCH
 NOTHROW = no
+# OpenMP threading
+OPENMP = no
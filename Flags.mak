@@ -66,6 +66,12 @@ else
   GLLIB = 
 endif
 
+ifeq ($(OPENMP),yes)
+  OPENMP = -fopenmp -DOPENMP
+else
+  OPENMP =
+endif
+
 ifeq ($(LOCAL_BODIES),yes)
   LOCAL_BODIES = -DLOCAL_BODIES
 else
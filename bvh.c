@@ -0,0 +1,890 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Tomasz Koziara
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * bvh.c: bounding volume hierarchy of triangles
+ */
+
+#include <float.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "bvh.h"
+#include "alg.h"
+#include "err.h"
+#include "tsi.h"
+
+#define BINS 16 /* number of surface area heuristic bins per axis */
+#define MAX_LEAF 8 /* largest leaf accepted by the cost model */
+#define MAX_DEPTH 32 /* depth from which median splits bound the tree height */
+#define STACK 128 /* traversal stack size => exceeds MAX_DEPTH plus the median split depth */
+#define TASK_SIZE 4096 /* smallest subtree built as a separate task */
+
+typedef struct reference REF; /* triangle reference */
+struct reference
+{
+  double box [6]; /* triangle extents */
+  double cen [3]; /* triangle centroid */
+  int idx; /* triangle index */
+};
+
+typedef struct build BUILD; /* construction data */
+struct build
+{
+  REF *ref; /* triangle references => partitioned in place, so that nodes scan them sequentially */
+  BVHNODE *node; /* sparse node table of size 2n-1 */
+};
+
+/* initialise empty extents */
+inline static void empty (double *e)
+{
+  e [0] = e [1] = e [2] = DBL_MAX;
+  e [3] = e [4] = e [5] = -DBL_MAX;
+}
+
+/* grow extents 'e' by extents 'f' (written as selections, which compile without branches) */
+inline static void grow (double *e, double *f)
+{
+  e [0] = f [0] < e [0] ? f [0] : e [0];
+  e [1] = f [1] < e [1] ? f [1] : e [1];
+  e [2] = f [2] < e [2] ? f [2] : e [2];
+  e [3] = f [3] > e [3] ? f [3] : e [3];
+  e [4] = f [4] > e [4] ? f [4] : e [4];
+  e [5] = f [5] > e [5] ? f [5] : e [5];
+}
+
+/* half surface area of extents */
+inline static double area (double *e)
+{
+  double d [3] = {e [3] - e [0], e [4] - e [1], e [5] - e [2]};
+
+  return d [0]*d [1] + d [1]*d [2] + d [2]*d [0];
+}
+
+/* extents overlap test */
+inline static int overlap (double *e, double *f)
+{
+  return e [0] <= f [3] && e [1] <= f [4] && e [2] <= f [5] &&
+         f [0] <= e [3] && f [1] <= e [4] && f [2] <= e [5];
+}
+
+/* squared distance between a point and extents */
+inline static double boxdist (double *e, double *p)
+{
+  double d, x;
+  int k;
+
+  for (d = 0.0, k = 0; k < 3; k ++)
+  {
+    if (p [k] < e [k]) { x = e [k] - p [k]; d += x*x; }
+    else if (p [k] > e [k+3]) { x = p [k] - e [k+3]; d += x*x; }
+  }
+
+  return d;
+}
+
+/* ray entry distance into extents or DBL_MAX if missed within 'tmax' */
+inline static double slab (double *e, double *o, double *inv, double tmax)
+{
+  double t0, t1, tn, tf, x;
+  int k;
+
+  for (tn = 0.0, tf = tmax, k = 0; k < 3; k ++)
+  {
+    t0 = (e [k] - o [k]) * inv [k];
+    t1 = (e [k+3] - o [k]) * inv [k];
+    if (t0 > t1) { x = t0; t0 = t1; t1 = x; }
+    if (t0 > tn) tn = t0; /* NaN from a zero direction on a slab plane is ignored */
+    if (t1 < tf) tf = t1;
+  }
+
+  return tn <= tf ? tn : DBL_MAX;
+}
+
+/* ray-triangle intersection; update '*t' if a closer hit is found */
+static int raytri (double *o, double *d, double *a, double *b, double *c, double *t)
+{
+  double e1 [3], e2 [3], p [3], q [3], s [3], det, inv, u, v, x;
+
+  SUB (b, a, e1);
+  SUB (c, a, e2);
+  PRODUCT (d, e2, p);
+  det = DOT (e1, p);
+  if (det == 0.0) return 0;
+  inv = 1.0 / det;
+
+  SUB (o, a, s);
+  u = DOT (s, p) * inv;
+  if (u < 0.0 || u > 1.0) return 0;
+
+  PRODUCT (s, e1, q);
+  v = DOT (d, q) * inv;
+  if (v < 0.0 || u + v > 1.0) return 0;
+
+  x = DOT (e2, q) * inv;
+  if (x < 0.0 || x > *t) return 0;
+
+  *t = x;
+  return 1;
+}
+
+/* closest triangle features => indices of the pseudo-normals of a BVHSURF triangle */
+enum {VERTEX_A = 0, VERTEX_B, VERTEX_C, EDGE_AB, EDGE_BC, EDGE_CA, INTERIOR};
+
+/* closest point 'q' on triangle (a, b, c) to point 'p'; return the closest feature */
+static int closest_point (double *p, double *a, double *b, double *c, double *q)
+{
+  double ab [3], ac [3], ap [3], bp [3], cp [3], bc [3],
+         d1, d2, d3, d4, d5, d6, va, vb, vc, v, w;
+
+  SUB (b, a, ab);
+  SUB (c, a, ac);
+  SUB (p, a, ap);
+  d1 = DOT (ab, ap);
+  d2 = DOT (ac, ap);
+  if (d1 <= 0.0 && d2 <= 0.0) { COPY (a, q); return VERTEX_A; }
+
+  SUB (p, b, bp);
+  d3 = DOT (ab, bp);
+  d4 = DOT (ac, bp);
+  if (d3 >= 0.0 && d4 <= d3) { COPY (b, q); return VERTEX_B; }
+
+  vc = d1*d4 - d3*d2;
+  if (vc <= 0.0 && d1 >= 0.0 && d3 <= 0.0)
+  {
+    v = d1 / (d1 - d3);
+    ADDMUL (a, v, ab, q);
+    return EDGE_AB;
+  }
+
+  SUB (p, c, cp);
+  d5 = DOT (ab, cp);
+  d6 = DOT (ac, cp);
+  if (d6 >= 0.0 && d5 <= d6) { COPY (c, q); return VERTEX_C; }
+
+  vb = d5*d2 - d1*d6;
+  if (vb <= 0.0 && d2 >= 0.0 && d6 <= 0.0)
+  {
+    w = d2 / (d2 - d6);
+    ADDMUL (a, w, ac, q);
+    return EDGE_CA;
+  }
+
+  va = d3*d6 - d5*d4;
+  if (va <= 0.0 && (d4 - d3) >= 0.0 && (d5 - d6) >= 0.0)
+  {
+    w = (d4 - d3) / ((d4 - d3) + (d5 - d6));
+    SUB (c, b, bc);
+    ADDMUL (b, w, bc, q);
+    return EDGE_BC;
+  }
+
+  w = 1.0 / (va + vb + vc);
+  v = vb * w;
+  w = vc * w;
+  q [0] = a [0] + ab [0]*v + ac [0]*w;
+  q [1] = a [1] + ab [1]*v + ac [1]*w;
+  q [2] = a [2] + ab [2]*v + ac [2]*w;
+  return INTERIOR;
+}
+
+/* squared point-triangle distance; output the closest feature if 'feature' is not NULL */
+inline static double tridist (TRI *t, double *p, double *q, int *feature)
+{
+  double d [3];
+  int f;
+
+  f = closest_point (p, t->ver [0], t->ver [1], t->ver [2], q);
+  if (feature) *feature = f;
+  SUB (q, p, d);
+
+  return DOT (d, d);
+}
+
+/* partition indices [lo, hi) about their median centroid coordinate 'd' */
+static void median (BUILD *b, int lo, int hi, int d)
+{
+  REF *ref = b->ref, x;
+  double pivot;
+  int k, i, j;
+
+  k = (lo + hi) / 2;
+
+  while (hi - lo > 1)
+  {
+    pivot = ref [(lo + hi) / 2].cen [d];
+
+    for (i = lo, j = hi - 1; i <= j; )
+    {
+      while (ref [i].cen [d] < pivot) i ++;
+      while (ref [j].cen [d] > pivot) j --;
+      if (i <= j) { x = ref [i]; ref [i] = ref [j]; ref [j] = x; i ++; j --; }
+    }
+
+    if (k <= j) hi = j + 1;
+    else if (k >= i) lo = i;
+    else break;
+  }
+}
+
+/* build node 'i' over triangles [lo, hi); descendants are stored from 'slot' onwards,
+ * where a subtree of k triangles uses at most 2k-2 slots, which makes the layout
+ * of concurrently built subtrees independent of the thread schedule */
+static void build (BUILD *b, int i, int lo, int hi, int slot, int depth)
+{
+  double cb [6], bins [3][BINS][6], right [BINS][6], scale [3], *e, *c, cost, best, a;
+  int count [3][BINS], rcount [BINS], n, j, k, d, s, axis, split, mid;
+  BVHNODE *node = &b->node [i];
+  REF *ref = b->ref, x;
+
+  e = node->extents;
+  empty (e);
+  empty (cb);
+  for (j = lo; j < hi; j ++)
+  {
+    grow (e, ref [j].box);
+    c = ref [j].cen;
+    cb [0] = c [0] < cb [0] ? c [0] : cb [0];
+    cb [1] = c [1] < cb [1] ? c [1] : cb [1];
+    cb [2] = c [2] < cb [2] ? c [2] : cb [2];
+    cb [3] = c [0] > cb [3] ? c [0] : cb [3];
+    cb [4] = c [1] > cb [4] ? c [1] : cb [4];
+    cb [5] = c [2] > cb [5] ? c [2] : cb [5];
+  }
+
+  n = hi - lo;
+
+  if (n == 1) goto leaf;
+
+  d = 0; /* widest centroid axis */
+  if (cb [4] - cb [1] > cb [d+3] - cb [d]) d = 1;
+  if (cb [5] - cb [2] > cb [d+3] - cb [d]) d = 2;
+
+  if (depth >= MAX_DEPTH) goto halve;
+
+  best = DBL_MAX;
+  axis = split = -1;
+
+  for (d = 0; d < 3; d ++) /* binned surface area heuristic => all axes binned in one pass */
+  {
+    scale [d] = cb [d+3] > cb [d] ? (double) BINS / (cb [d+3] - cb [d]) : 0.0;
+    for (k = 0; k < BINS; k ++) { empty (bins [d][k]); count [d][k] = 0; }
+  }
+
+  for (j = lo; j < hi; j ++)
+  {
+    for (d = 0; d < 3; d ++)
+    {
+      k = (int) ((ref [j].cen [d] - cb [d]) * scale [d]);
+      if (k >= BINS) k = BINS - 1;
+      grow (bins [d][k], ref [j].box);
+      count [d][k] ++;
+    }
+  }
+
+  for (d = 0; d < 3; d ++)
+  {
+    if (scale [d] == 0.0) continue;
+
+    COPY6 (bins [d][BINS-1], right [BINS-1]);
+    rcount [BINS-1] = count [d][BINS-1];
+    for (k = BINS-2; k > 0; k --)
+    {
+      COPY6 (right [k+1], right [k]);
+      grow (right [k], bins [d][k]);
+      rcount [k] = rcount [k+1] + count [d][k];
+    }
+
+    for (s = 0, k = 0; k < BINS-1; k ++) /* split after bin k */
+    {
+      s += count [d][k];
+      if (k) grow (bins [d][k], bins [d][k-1]);
+      if (s == 0 || rcount [k+1] == 0) continue;
+
+      cost = area (bins [d][k]) * s + area (right [k+1]) * rcount [k+1];
+      if (cost < best) { best = cost; axis = d; split = k; }
+    }
+  }
+
+  if (axis < 0) /* all centroids coincide */
+  {
+    if (n <= MAX_LEAF) goto leaf;
+    d = 0;
+    goto halve;
+  }
+
+  a = area (e);
+  if (n <= MAX_LEAF && a + best >= a * n) goto leaf; /* unit traversal and triangle costs */
+
+  for (j = lo, k = hi - 1; j <= k; ) /* partition by bins */
+  {
+    s = (int) ((ref [j].cen [axis] - cb [axis]) * scale [axis]);
+    if (s >= BINS) s = BINS - 1;
+    if (s <= split) j ++;
+    else { x = ref [j]; ref [j] = ref [k]; ref [k] = x; k --; }
+  }
+  mid = j;
+  goto inner;
+
+halve:
+  median (b, lo, hi, d);
+  mid = (lo + hi) / 2;
+
+inner:
+  ASSERT_DEBUG (lo < mid && mid < hi, "Invalid split");
+  node->first = slot;
+  node->count = 0;
+
+#if OPENMP
+  #pragma omp task if (mid - lo > TASK_SIZE)
+#endif
+  build (b, slot, lo, mid, slot + 2, depth + 1);
+
+#if OPENMP
+  #pragma omp task if (hi - mid > TASK_SIZE)
+#endif
+  build (b, slot + 1, mid, hi, slot + 2*(mid - lo), depth + 1);
+
+  return;
+
+leaf:
+  node->first = lo;
+  node->count = n;
+}
+
+/* count nodes of a subtree */
+static int size (BVHNODE *node, int i)
+{
+  return node [i].count ? 1 : 1 + size (node, node [i].first) + size (node, node [i].first + 1);
+}
+
+/* copy the sparse subtree 'i' into the compact node 'j'; '*n' is the next free node */
+static void compact (BVHNODE *src, int i, BVHNODE *dst, int j, int *n)
+{
+  dst [j] = src [i];
+
+  if (src [i].count == 0)
+  {
+    dst [j].first = *n;
+    *n += 2;
+    compact (src, src [i].first, dst, dst [j].first, n);
+    compact (src, src [i].first + 1, dst, dst [j].first + 1, n);
+  }
+}
+
+/* create a surface area heuristic hierarchy of triangles */
+BVH* BVH_Create (TRI *tri, int n)
+{
+  double *v, *w, *x;
+  BUILD b;
+  BVH *bvh;
+  int i, m;
+
+  if (n == 0)
+  {
+    ERRMEM (bvh = malloc (sizeof (BVH)));
+    bvh->node = NULL;
+    bvh->tri = NULL;
+    bvh->nnode = bvh->ntri = 0;
+    return bvh;
+  }
+
+  ERRMEM (b.ref = malloc (sizeof (REF) * n));
+  ERRMEM (b.node = malloc (sizeof (BVHNODE) * (2*n - 1)));
+
+#if OPENMP
+  #pragma omp parallel for private (v, w, x)
+#endif
+  for (i = 0; i < n; i ++)
+  {
+    TRI_Extents (&tri [i], b.ref [i].box);
+    v = tri [i].ver [0];
+    w = tri [i].ver [1];
+    x = tri [i].ver [2];
+    MID3 (v, w, x, b.ref [i].cen);
+    b.ref [i].idx = i;
+  }
+
+#if OPENMP
+  #pragma omp parallel
+  #pragma omp single
+#endif
+  build (&b, 0, 0, n, 1, 0);
+
+  m = size (b.node, 0);
+  ERRMEM (bvh = malloc (sizeof (BVH) + sizeof (BVHNODE) * m + sizeof (TRI*) * n));
+  bvh->node = (BVHNODE*) (bvh + 1);
+  bvh->tri = (TRI**) (bvh->node + m);
+  bvh->nnode = m;
+  bvh->ntri = n;
+
+  for (i = 0; i < n; i ++) bvh->tri [i] = &tri [b.ref [i].idx];
+
+  i = 1;
+  compact (b.node, 0, bvh->node, 0, &i);
+  ASSERT_DEBUG (i == m, "Inconsistent node count");
+
+  free (b.node);
+  free (b.ref);
+
+  return bvh;
+}
+
+/* report triangles whose extents overlap the extents */
+int BVH_Extents (BVH *bvh, double *extents, void *data, BVH_Callback callback)
+{
+  int stack [STACK], top, count;
+  double ext [6];
+  TRI **t, **e;
+  BVHNODE *nd;
+
+  if (bvh->nnode == 0) return 0;
+
+  for (stack [0] = 0, top = 1, count = 0; top; )
+  {
+    nd = &bvh->node [stack [-- top]];
+
+    if (!overlap (nd->extents, extents)) continue;
+
+    if (nd->count)
+    {
+      for (t = bvh->tri + nd->first, e = t + nd->count; t < e; t ++)
+      {
+	TRI_Extents (*t, ext);
+	if (overlap (ext, extents))
+	{
+	  if (callback) callback (data, *t);
+	  count ++;
+	}
+      }
+    }
+    else
+    {
+      ASSERT_DEBUG (top + 2 <= STACK, "Stack overflow");
+      stack [top ++] = nd->first + 1;
+      stack [top ++] = nd->first;
+    }
+  }
+
+  return count;
+}
+
+/* report triangles intersecting the sphere */
+int BVH_Sphere (BVH *bvh, double *center, double radius, void *data, BVH_Callback callback)
+{
+  int stack [STACK], top, count;
+  double q [3], r;
+  TRI **t, **e;
+  BVHNODE *nd;
+
+  if (bvh->nnode == 0) return 0;
+
+  r = radius * radius;
+
+  for (stack [0] = 0, top = 1, count = 0; top; )
+  {
+    nd = &bvh->node [stack [-- top]];
+
+    if (boxdist (nd->extents, center) > r) continue;
+
+    if (nd->count)
+    {
+      for (t = bvh->tri + nd->first, e = t + nd->count; t < e; t ++)
+      {
+	if (tridist (*t, center, q, NULL) <= r)
+	{
+	  if (callback) callback (data, *t);
+	  count ++;
+	}
+      }
+    }
+    else
+    {
+      ASSERT_DEBUG (top + 2 <= STACK, "Stack overflow");
+      stack [top ++] = nd->first + 1;
+      stack [top ++] = nd->first;
+    }
+  }
+
+  return count;
+}
+
+/* return the first triangle hit by the ray */
+TRI* BVH_Ray (BVH *bvh, double *origin, double *direction, double *tmax)
+{
+  double inv [3], best, tl, tr;
+  int stack [STACK], top, l;
+  TRI **t, **e, *hit;
+  BVHNODE *nd;
+
+  if (bvh->nnode == 0) return NULL;
+
+  inv [0] = 1.0 / direction [0];
+  inv [1] = 1.0 / direction [1];
+  inv [2] = 1.0 / direction [2];
+  best = *tmax;
+  hit = NULL;
+
+  if (slab (bvh->node [0].extents, origin, inv, best) == DBL_MAX) return NULL;
+
+  for (stack [0] = 0, top = 1; top; )
+  {
+    nd = &bvh->node [stack [-- top]];
+
+    if (nd->count)
+    {
+      for (t = bvh->tri + nd->first, e = t + nd->count; t < e; t ++)
+      {
+	if (raytri (origin, direction, (*t)->ver [0], (*t)->ver [1], (*t)->ver [2], &best)) hit = *t;
+      }
+    }
+    else /* children entered within the current best distance; the nearer is popped first */
+    {
+      l = nd->first;
+      tl = slab (bvh->node [l].extents, origin, inv, best);
+      tr = slab (bvh->node [l+1].extents, origin, inv, best);
+      ASSERT_DEBUG (top + 2 <= STACK, "Stack overflow");
+
+      if (tl <= tr)
+      {
+	if (tr != DBL_MAX) stack [top ++] = l+1;
+	if (tl != DBL_MAX) stack [top ++] = l;
+      }
+      else
+      {
+	if (tl != DBL_MAX) stack [top ++] = l;
+	if (tr != DBL_MAX) stack [top ++] = l+1;
+      }
+    }
+  }
+
+  if (hit) *tmax = best;
+
+  return hit;
+}
+
+/* return the triangle closest to the point and its closest feature */
+static TRI* nearest (BVH *bvh, double *point, double *closest, double *dist, int *feature)
+{
+  double q [3], d, dl, dr, best;
+  int stack [STACK], top, l, f;
+  TRI **t, **e, *min;
+  BVHNODE *nd;
+
+  if (bvh->nnode == 0) return NULL;
+
+  best = *dist;
+  min = NULL;
+
+  for (stack [0] = 0, top = 1; top; )
+  {
+    nd = &bvh->node [stack [-- top]];
+
+    if (boxdist (nd->extents, point) >= best) continue; /* 'best' might have dropped since the push */
+
+    if (nd->count)
+    {
+      for (t = bvh->tri + nd->first, e = t + nd->count; t < e; t ++)
+      {
+	d = tridist (*t, point, q, &f);
+	if (d < best)
+	{
+	  best = d;
+	  min = *t;
+	  *feature = f;
+	  COPY (q, closest);
+	}
+      }
+    }
+    else
+    {
+      l = nd->first;
+      dl = boxdist (bvh->node [l].extents, point);
+      dr = boxdist (bvh->node [l+1].extents, point);
+      ASSERT_DEBUG (top + 2 <= STACK, "Stack overflow");
+
+      if (dl <= dr)
+      {
+	if (dr < best) stack [top ++] = l+1;
+	if (dl < best) stack [top ++] = l;
+      }
+      else
+      {
+	if (dl < best) stack [top ++] = l;
+	if (dr < best) stack [top ++] = l+1;
+      }
+    }
+  }
+
+  if (min) *dist = best;
+
+  return min;
+}
+
+/* return the triangle closest to the point */
+TRI* BVH_Closest (BVH *bvh, double *point, double *closest, double *dist)
+{
+  int feature;
+
+  return nearest (bvh, point, closest, dist, &feature);
+}
+
+/* find closest triangles of many points */
+void BVH_Closest_Batch (BVH *bvh, double *point, int n, double *closest, double *dist, TRI **tri)
+{
+  TRI *t;
+  int i;
+
+#if OPENMP
+  #pragma omp parallel for schedule (dynamic, 256) private (t)
+#endif
+  for (i = 0; i < n; i ++)
+  {
+    dist [i] = DBL_MAX;
+    t = BVH_Closest (bvh, &point [3*i], &closest [3*i], &dist [i]);
+    if (tri) tri [i] = t;
+  }
+}
+
+/* free the hierarchy */
+void BVH_Destroy (BVH *bvh)
+{
+  free (bvh);
+}
+
+/* angle at vertex 'a' of triangle (a, b, c) */
+static double angle (double *a, double *b, double *c)
+{
+  double u [3], v [3], w [3];
+
+  SUB (b, a, u);
+  SUB (c, a, v);
+  PRODUCT (u, v, w);
+
+  return atan2 (LEN (w), DOT (u, v));
+}
+
+/* prepare a closed surface for signed distance queries */
+BVHSURF* BVH_Surface (TRI *tri, int n)
+{
+  double *vnl, *unl, *p, *q, w;
+  TRIMESH *mesh;
+  BVHSURF *surf;
+  int i, j, k;
+
+  ERRMEM (surf = malloc (sizeof (BVHSURF) + sizeof (double [18]) * n));
+  surf->pnl = (double*) (surf + 1);
+  surf->tri = tri;
+  surf->n = n;
+  surf->bvh = BVH_Create (tri, n);
+
+  if (n == 0) return surf;
+
+  /* vertex indices and adjacency independent of the 'adj' members */
+  mesh = TRI_Tomesh (tri, n, NULL, 0);
+  TRI_Meshadj (mesh);
+
+  ERRMEM (vnl = calloc (mesh->nv, sizeof (double [3])));
+  ERRMEM (unl = malloc (sizeof (double [3]) * n));
+
+  for (j = 0; j < n; j ++) /* unit face normals => 'out' need not be normalized */
+  {
+    q = &unl [3*j];
+    COPY (tri [j].out, q);
+    w = LEN (q);
+    if (w > 0.0) { DIV (q, w, q); }
+  }
+
+  for (j = 0; j < n; j ++) /* angle weighted vertex normals */
+  {
+    for (i = 0; i < 3; i ++)
+    {
+      w = angle (tri [j].ver [i], tri [j].ver [(i+1)%3], tri [j].ver [(i+2)%3]);
+      p = &vnl [3 * mesh->tri [3*j+i]];
+      ADDMUL (p, w, &unl [3*j], p);
+    }
+  }
+
+#if OPENMP
+  #pragma omp parallel for private (i, k, p, q)
+#endif
+  for (j = 0; j < n; j ++)
+  {
+    p = &surf->pnl [18*j];
+
+    for (i = 0; i < 3; i ++, p += 3)
+    {
+      q = &vnl [3 * mesh->tri [3*j+i]];
+      COPY (q, p);
+    }
+
+    for (i = 0; i < 3; i ++, p += 3) /* edge normals => sums of the adjacent face normals */
+    {
+      k = mesh->adj [3*j+i];
+      if (k >= 0) { ADD (&unl [3*j], &unl [3*k], p); }
+      else { COPY (&unl [3*j], p); }
+    }
+  }
+
+  free (unl);
+  free (vnl);
+  free (mesh);
+
+  return surf;
+}
+
+/* signed distance from a point to a surface */
+double BVH_Distance (BVHSURF *surf, double *point, double *closest, TRI **tri)
+{
+  double q [3], d [3], dist, *nl;
+  int feature;
+  TRI *t;
+
+  dist = DBL_MAX;
+  t = nearest (surf->bvh, point, q, &dist, &feature);
+  if (tri) *tri = t;
+  if (!t) return DBL_MAX;
+
+  nl = feature == INTERIOR ? t->out : &surf->pnl [18*(t - surf->tri) + 3*feature];
+  SUB (point, q, d);
+  dist = sqrt (dist);
+  if (DOT (d, nl) < 0.0) dist = -dist;
+  if (closest) { COPY (q, closest); }
+
+  return dist;
+}
+
+/* signed distances from many points to a surface */
+void BVH_Distance_Batch (BVHSURF *surf, double *point, int n, double *dist, double *closest)
+{
+  int i;
+
+#if OPENMP
+  #pragma omp parallel for schedule (dynamic, 256)
+#endif
+  for (i = 0; i < n; i ++)
+  {
+    dist [i] = BVH_Distance (surf, &point [3*i], closest ? &closest [3*i] : NULL, NULL);
+  }
+}
+
+/* free the surface */
+void BVH_Surface_Destroy (BVHSURF *surf)
+{
+  BVH_Destroy (surf->bvh);
+  free (surf);
+}
+
+/* topological adjacency seed search data */
+struct seed
+{
+  double *point;
+  double radius;
+  TRI *seed;
+};
+
+/* keep the first in the input order triangle near the point */
+static void seed (void *ptr, TRI *t)
+{
+  struct seed *data = ptr;
+
+  if ((data->seed == NULL || t < data->seed) &&
+      TSI_Status (t->ver [0], t->ver [1], t->ver [2], data->point, data->radius) != TSI_OUT) data->seed = t;
+}
+
+/* prepare a surface for repeated topological adjacency queries */
+BVHTOPO* BVH_Topology (TRI *tri, int n)
+{
+  BVHTOPO *topo;
+
+  ERRMEM (topo = malloc (sizeof (BVHTOPO) + sizeof (TRI*) * n + sizeof (int) * n));
+  topo->list = (TRI**) (topo + 1);
+  topo->stamp = (int*) (topo->list + n);
+  memset (topo->stamp, 0, sizeof (int) * n);
+  topo->epoch = 0;
+  topo->tri = tri;
+  topo->n = n;
+  topo->bvh = BVH_Create (tri, n);
+
+  return topo;
+}
+
+/* list triangles topologically adjacent to a point */
+TRI** BVH_Topoadj (BVHTOPO *topo, double *point, int *m)
+{
+  TRI *t, *s, **list = topo->list;
+  struct seed data;
+  int i, j, k;
+
+  data.point = point;
+  data.radius = 10 * GEOMETRIC_EPSILON;
+  data.seed = NULL;
+
+  BVH_Sphere (topo->bvh, point, data.radius, &data, seed);
+
+  if (data.seed == NULL)
+  {
+    *m = 0;
+    return NULL;
+  }
+
+  if (topo->epoch == INT_MAX) /* stamps wrap around */
+  {
+    memset (topo->stamp, 0, sizeof (int) * topo->n);
+    topo->epoch = 0;
+  }
+
+  topo->epoch ++;
+
+  list [0] = data.seed;
+  topo->stamp [data.seed - topo->tri] = topo->epoch;
+
+  for (j = 0, k = 1; j < k; j ++) /* breadth first fill, using the output list as the queue */
+  {
+    t = list [j];
+
+    for (i = 0; i < 3; i ++)
+    {
+      s = t->adj [i];
+
+      if (s && topo->stamp [s - topo->tri] != topo->epoch)
+      {
+	topo->stamp [s - topo->tri] = topo->epoch;
+	list [k ++] = s;
+      }
+    }
+  }
+
+  *m = k;
+
+  return list;
+}
+
+/* free the prepared surface */
+void BVH_Topology_Destroy (BVHTOPO *topo)
+{
+  BVH_Destroy (topo->bvh);
+  free (topo);
+}
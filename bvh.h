@@ -0,0 +1,126 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Tomasz Koziara
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * bvh.h: bounding volume hierarchy of triangles
+ */
+
+#include "tri.h"
+
+#ifndef __bvh__
+#define __bvh__
+
+typedef struct bvh_node BVHNODE; /* hierarchy node */
+struct bvh_node
+{
+  double extents [6]; /* min x, y, z, max x, y, z */
+  int first; /* first triangle of a leaf or the left child of an inner node (the right child follows it) */
+  int count; /* number of leaf triangles or 0 for an inner node */
+};
+
+typedef struct bvh BVH; /* bounding volume hierarchy */
+struct bvh
+{
+  BVHNODE *node; /* flat node array; node [0] is the root */
+  TRI **tri; /* triangle pointers ordered by leaves */
+  int nnode, ntri;
+};
+
+typedef struct bvh_surface BVHSURF; /* surface prepared for signed distance queries */
+struct bvh_surface
+{
+  BVH *bvh; /* hierarchy of the surface triangles */
+  TRI *tri; /* surface triangles */
+  double *pnl; /* angle weighted pseudo-normals of vertices a, b, c and edges ab, bc, ca; of size (double [18]) x n */
+  int n;
+};
+
+typedef struct bvh_topology BVHTOPO; /* surface prepared for repeated TRI_Topoadj like queries */
+struct bvh_topology
+{
+  BVH *bvh; /* hierarchy of the surface triangles */
+  TRI *tri; /* surface triangles */
+  TRI **list; /* output list of size n */
+  int *stamp; /* triangle visit stamps of size n */
+  int epoch; /* stamp of the last query */
+  int n;
+};
+
+typedef void (*BVH_Callback) (void *data, TRI *t); /* query callback */
+
+/* create a surface area heuristic hierarchy of triangles (tri, n); with OPENMP large
+ * subtrees are built in parallel, while the node layout does not depend on threading;
+ * 'tri' is referenced rather than copied, hence it must outlive the hierarchy */
+BVH* BVH_Create (TRI *tri, int n);
+
+/* report triangles whose extents overlap the extents; return their number */
+int BVH_Extents (BVH *bvh, double *extents, void *data, BVH_Callback callback);
+
+/* report triangles intersecting the sphere (center, radius); return their number */
+int BVH_Sphere (BVH *bvh, double *center, double radius, void *data, BVH_Callback callback);
+
+/* return the first triangle hit by the ray (origin, direction) within the distance *tmax,
+ * measured in the units of the direction length; update *tmax to the hit distance;
+ * return NULL if nothing is hit */
+TRI* BVH_Ray (BVH *bvh, double *origin, double *direction, double *tmax);
+
+/* return the triangle closest to the point, within the squared distance *dist;
+ * output the closest point and update *dist; return NULL if nothing is found;
+ * pass *dist = DBL_MAX for an unbounded search */
+TRI* BVH_Closest (BVH *bvh, double *point, double *closest, double *dist);
+
+/* find closest triangles of 'n' points, as in BVH_Closest with an unbounded search;
+ * output closest points (double [3]) x n, squared distances and optionally triangles */
+void BVH_Closest_Batch (BVH *bvh, double *point, int n, double *closest, double *dist, TRI **tri);
+
+/* free the hierarchy */
+void BVH_Destroy (BVH *bvh);
+
+/* prepare a closed surface (tri, n), e.g. (TRISURF->tri, TRISURF->m), for signed distance
+ * queries; outward normals 'out' must be valid, 'adj' members are not used; 'tri' is referenced */
+BVHSURF* BVH_Surface (TRI *tri, int n);
+
+/* return the signed distance from a point to the surface (negative inside); optionally output
+ * the closest point and triangle; the sign follows the pseudo-normal of the closest feature */
+double BVH_Distance (BVHSURF *surf, double *point, double *closest, TRI **tri);
+
+/* compute signed distances of 'n' points; 'closest' points (double [3]) x n can be NULL */
+void BVH_Distance_Batch (BVHSURF *surf, double *point, int n, double *dist, double *closest);
+
+/* free the surface */
+void BVH_Surface_Destroy (BVHSURF *surf);
+
+/* prepare a surface (tri, n) with valid adjacency for repeated topological adjacency queries;
+ * 'tri' is referenced and must not be reordered; the queries are not thread-safe */
+BVHTOPO* BVH_Topology (TRI *tri, int n);
+
+/* as TRI_Topoadj, but without reordering or flagging the input triangles; return a list of 'm'
+ * triangles connected through 'adj' to the first in the input order triangle near the point;
+ * the list is valid until the next query; return NULL and *m = 0 if no triangle is near */
+TRI** BVH_Topoadj (BVHTOPO *topo, double *point, int *m);
+
+/* free the prepared surface */
+void BVH_Topology_Destroy (BVHTOPO *topo);
+
+#endif
@@ -29,16 +29,57 @@
 #include <stdlib.h>
 #include <string.h>
 #include <float.h>
+#if OPENMP
+#include <omp.h>
+#endif
 #include "cvi.h"
 #include "hul.h"
+#include "mem.h"
 #include "alg.h"
 #include "gjk.h"
 #include "err.h"
 
+/* plane slot: [0, npa) for 'a' and [npa, npa+npb) for 'b' */
+#define SLOT(flg, npa) ((flg) > 0 ? (flg) - 1 : (npa) - (flg) - 1)
+
+/* plane of 'a' or 'b' given its signed 1-based index */
+#define PLANE_OF(flg, pa, pb) ((flg) > 0 ? (pa) + 6*((flg) - 1) : (pb) + 6*(-(flg) - 1))
+
+/* push 'p' by 'eps' along the normals of planes 'pl' it is not
+ * safely inside of; return 1 if 'p' has been pushed at all */
+static int push_point (double *pl, int np, double *p, double eps)
+{
+  double *end, d, q [3];
+  int pushed;
+
+  for (pushed = 0, end = pl + np * 6; pl < end; pl += 6)
+  {
+    SUB (p, pl + 3, q);
+    d = DOT (pl, q);
+    if (d > -GEOMETRIC_EPSILON) { SUBMUL (p, eps, pl, p); pushed = 1; }
+  }
+
+  return pushed;
+}
+
+/* test whether 'p' is not outside of any of planes 'pl' by more than 'eps' */
+static int point_inside (double *pl, int np, double *p, double eps)
+{
+  double *end, q [3];
+
+  for (end = pl + np * 6; pl < end; pl += 6)
+  {
+    SUB (p, pl + 3, q);
+    if (DOT (pl, q) > eps) return 0;
+  }
+
+  return 1;
+}
+
 /* push 'p' deeper inside of convices bounded by two plane sets */
 static int refine_point (double *pa, int npa, double *pb, int npb, double *p, double *epsout)
 {
-  double *pla, *end, eps, d, q [3];
+  double eps;
   short pushed, iter, imax;
 
   imax = 4;
@@ -46,19 +87,31 @@ static int refine_point (double *pa, int npa, double *pb, int npb, double *p, do
   eps = GEOMETRIC_EPSILON * (1 << (imax + 1));
   do
   {
-    for (pushed = 0, pla = pa, end = pa + npa * 6; pla < end; pla += 6)
-    {
-      SUB (p, pla + 3, q);
-      d = DOT (pla, q);
-      if (d > -GEOMETRIC_EPSILON) { SUBMUL (p, eps, pla, p); pushed = 1; }
-    }
+    pushed = push_point (pa, npa, p, eps);
+    pushed |= push_point (pb, npb, p, eps);
 
-    for (pla = pb, end = pb + npb * 6; pla < end; pla += 6)
-    {
-      SUB (p, pla + 3, q);
-      d = DOT (pla, q);
-      if (d > -GEOMETRIC_EPSILON) { SUBMUL (p, eps, pla, p); pushed = 1; }
-    }
+    eps *= 0.5;
+
+  } while (pushed && iter ++ < imax);
+
+  *epsout = 10 * eps;
+
+  return !pushed;
+}
+
+/* push 'p' deeper inside of 'k' convices */
+static int refine_multi (CVICONVEX *cvx, int k, double *p, double *epsout)
+{
+  double eps;
+  short pushed, iter, imax;
+  int j;
+
+  imax = 4;
+  iter = 0;
+  eps = GEOMETRIC_EPSILON * (1 << (imax + 1));
+  do
+  {
+    for (j = pushed = 0; j < k; j ++) pushed |= push_point (cvx[j].p, cvx[j].np, p, eps);
 
     eps *= 0.5;
 
@@ -69,6 +122,93 @@ static int refine_point (double *pa, int npa, double *pb, int npb, double *p, do
   return !pushed;
 }
 
+/* find a point common to 'k' convices as the vertex centroid of their running
+ * pairwise (non-regularized) intersection; return 0 if it becomes empty */
+static int running_point (CVICONVEX *cvx, int k, double *p, ARENA *arena)
+{
+  double *v, *pl, *q, *r;
+  int i, j, m, nv, np, *slot;
+  TRI *tri, *t;
+
+  v = cvx[0].v;
+  nv = cvx[0].nv;
+  pl = cvx[0].p;
+  np = cvx[0].np;
+
+  for (j = 1, q = NULL, tri = NULL; j < k; j ++, pl = q, tri = t)
+  {
+    t = cvi_arena (v, nv, pl, np, cvx[j].v, cvx[j].nv, cvx[j].p, cvx[j].np, NON_REGULARIZED, &m, &v, &nv, NULL, arena);
+
+    if (t) /* planes of the intersection, each once */
+    {
+      ERRMEM (slot = ARENA_Alloc (arena, sizeof (int) * (np + cvx[j].np)));
+      for (i = 0; i < np + cvx[j].np; i ++) slot [i] = 0;
+      ERRMEM (q = ARENA_Alloc (arena, sizeof (double [6]) * m));
+
+      for (i = 0, r = q; i < m; i ++)
+      {
+	if (slot [SLOT (t[i].flg, np)]) continue;
+	slot [SLOT (t[i].flg, np)] = 1;
+	COPY6 (PLANE_OF (t[i].flg, pl, cvx[j].p), r);
+	r += 6;
+      }
+
+      if (!arena) free (slot);
+      np = (r - q) / 6;
+    }
+
+    if (!arena) { free (tri); if (j > 1) free (pl); }
+
+    if (!t) return 0;
+  }
+
+  SET (p, 0.0);
+  for (i = 0; i < nv; i ++) { ADD (p, v + 3*i, p); }
+  DIV (p, (double) nv, p);
+
+  if (!arena) { free (tri); if (k > 1) free (pl); }
+
+  return 1;
+}
+
+/* find a point common to 'k' convices by cyclic projections onto them, starting
+ * from the closest point of the first pair; the projections are iterated until
+ * the point is inside of all convices, their sweep displacement stagnates or the
+ * iteration bound is hit; the latter two cases (slow convergence for thin or barely
+ * overlapping convices) are resolved by the running pairwise intersection;
+ * return 0 if the convices are disjoint */
+static int multi_point (CVICONVEX *cvx, int k, double *p, ARENA *arena)
+{
+  double q [3], d, s, u;
+  int i, j, in;
+
+  if (k == 1)
+  {
+    SET (p, 0.0);
+    for (i = 0; i < cvx[0].nv; i ++) { ADD (p, cvx[0].v + 3*i, p); }
+    DIV (p, (double) cvx[0].nv, p);
+    return 1;
+  }
+
+  d = gjk (cvx[0].v, cvx[0].nv, cvx[1].v, cvx[1].nv, p, q);
+  if (d > GEOMETRIC_EPSILON) return 0;
+
+  for (i = 0, u = DBL_MAX; i < 256; i ++, u = s)
+  {
+    for (j = 0, in = 1, s = 0.0; j < k; j ++)
+    {
+      d = gjk_convex_point (cvx[j].v, cvx[j].nv, p, q);
+      if (d > GEOMETRIC_EPSILON) { COPY (q, p); s += d; in = 0; }
+    }
+
+    if (in) return 1;
+
+    if (s > 0.99 * u) break; /* stagnation */
+  }
+
+  return running_point (cvx, k, p, arena);
+}
+
 /* copute vertices extents */
 static void vertices_extents (double *va, int nva, double *vb, int nvb, double eps, double *e)
 {
@@ -103,6 +243,64 @@ static void vertices_extents (double *va, int nva, double *vb, int nvb, double e
   e [5] += eps;
 }
 
+/* support value of the extents 'e', relative to 'p', along 'n' */
+inline static double extents_support (double *e, double *p, double *n)
+{
+  return n [0] * ((n [0] > 0.0 ? e [3] : e [0]) - p [0]) +
+         n [1] * ((n [1] > 0.0 ? e [4] : e [1]) - p [1]) +
+         n [2] * ((n [2] > 0.0 ? e [5] : e [2]) - p [2]);
+}
+
+/* translate 'np' planes 'pl' so that 'p' becomes zero and output polar
+ * vertices 'nn' together with their signed 1-based plane indices 'idx';
+ * when 'x' is not NULL, planes whose half-spaces strictly contain the
+ * extents 'x' are culled (they can not touch the intersection contained
+ * in 'x' and hence they are redundant); return the number of outputs */
+static int polar_vertices (double *pl, int np, int sign, double *p, double eps, double *x, double *nn, int *idx)
+{
+  double *nl, *pt, q [3], d;
+  int i, k;
+
+  for (i = k = 0, nl = pl, pt = pl + 3; i < np; i ++, nl += 6, pt += 6)
+  {
+    SUB (pt, p, q); /* q => translated point of current plane */
+    d = - DOT (nl, q); /* d => zero offset */
+    if (x && d + extents_support (x, p, nl) < 0.0) continue; /* extents strictly inside => cull */
+    if (d > -GEOMETRIC_EPSILON) d = -eps; /* regularisation (tiny swelling) */
+    DIV (nl, -d, nn);  /* <nn, x> <= 1 (nn stores vertices of polar polygon) */
+    idx [k ++] = sign * (i + 1);
+    nn += 3;
+  }
+
+  return k;
+}
+
+/* test whether the vertices (v, nv), bounded by the extents 'e', are inside
+ * of all planes (pl, np) but those with non-negative 'map' entries; planes are
+ * first tested against the extents and only then against individual vertices */
+static int vertices_inside (double *v, int nv, double *e, double *pl, int np, int *map, double eps)
+{
+  double *nl, *pt, *x, *end, q [3], tol;
+
+  for (nl = pl, pt = pl + 3, end = pl + 6*np; nl < end; nl += 6, pt += 6, map ++)
+  {
+    if (*map >= 0) continue;
+
+    SUB (v, pt, q);
+    if (DOT (nl, q) + extents_support (e, v, nl) <= 0.0) continue;
+
+    tol = eps * LEN (nl);
+
+    for (x = v; x < v + 3*nv; x += 3)
+    {
+      SUB (x, pt, q);
+      if (DOT (nl, q) > tol) return 0;
+    }
+  }
+
+  return 1;
+}
+
 #if GEOMDEBUG
 /* dump errornous input */
 static void dump_input (double *va, int nva, double *pa, int npa, double *vb, int nvb, double *pb, int npb)
@@ -119,54 +317,197 @@ static void dump_input (double *va, int nva, double *pa, int npa, double *vb, in
 }
 #endif
 
-/* compute intersection of two convex polyhedrons */
-TRI* cvi (double *va, int nva, double *pa, int npa, double *vb, int nvb, double *pb, int npb, CVIKIND kind, int *m, double **pv, int *nv)
+/* record the active planes (vertices of the polar hull 'h') and the intersection
+ * vertices (triangles of 'h') together with the planes across the polar edges */
+static void cache_topology (CVICACHE *cache, TRI *h, int nh, double *yy, int *idx, int npa, int npb)
 {
-  double e [6], p [3], q [3], eps, d, *nl, *pt, *nn, *yy;
-  PFV *pfv, *v, *w, *z;
-  int i, j, k, n;
-  TRI *tri, *t;
+  int i, j, k, *ver;
+  TRI *t, *u;
 
-  /* initialize */
-  eps = GEOMETRIC_EPSILON;
-  tri = t = NULL;
-  pfv = NULL;
-  yy = NULL;
+  if (cache->size < npa+npb)
+  {
+    cache->size = npa+npb;
+    ERRMEM (cache->sel = realloc (cache->sel, sizeof (int) * cache->size));
+    ERRMEM (cache->map = realloc (cache->map, sizeof (int) * cache->size));
+    ERRMEM (cache->y = realloc (cache->y, sizeof (double [3]) * cache->size));
+  }
 
-  /* compute closest points */
-  d = gjk (va, nva, vb, nvb, p, q);
-  if (d > GEOMETRIC_EPSILON) { *m = 0; return NULL; }
+  if (cache->vsize < nh)
+  {
+    cache->vsize = nh;
+    ERRMEM (cache->ver = realloc (cache->ver, sizeof (int [6]) * nh));
+  }
 
-  /* push 'p' deeper inside only if regularized intersection is sought */
-  if (kind == REGULARIZED && !refine_point (pa, npa, pb, npb, p, &eps)) { *m = 0; return NULL; }
+  for (i = 0; i < npa+npb; i ++) cache->map [i] = -1;
 
-  /* vertices extents for a later sanity check */
-  vertices_extents (va, nva, vb, nvb, eps, e);
+  for (t = h, ver = cache->ver, cache->nsel = 0; t < h + nh; t ++, ver += 6)
+  {
+    for (j = 0; j < 3; j ++)
+    {
+      k = idx [(t->ver [j] - yy) / 3];
+      i = SLOT (k, npa);
+      if (cache->map [i] < 0)
+      {
+	cache->map [i] = cache->nsel;
+	cache->sel [cache->nsel ++] = k;
+      }
+      ver [j] = cache->map [i];
+    }
+  }
 
-  /* translate base points of planes so that
-   * p = q = 0; compute new normals 'yy' */
-  ERRMEM (yy = malloc (sizeof (double [3]) * (npa+npb)));
-  for (i = 0, nl = pa, pt = pa + 3, nn = yy;
-       i < npa; i ++, nl += 6, pt += 6, nn += 3)
+  for (t = h, ver = cache->ver; t < h + nh; t ++, ver += 6)
   {
-    SUB (pt, p, q); /* q => translated point of current plane */
-    d = - DOT (nl, q); /* d => zero offset */
-    if (d > -GEOMETRIC_EPSILON) d = -eps; /* regularisation (tiny swelling) */
-    DIV (nl, -d, nn);  /* <nn, x> <= 1 (yy stores vertices of polar polygon) */
+    for (j = 0; j < 3; j ++)
+    {
+      u = t->adj [j];
+      for (k = 0; k < 3; k ++) if (u->ver [k] != t->ver [0] && u->ver [k] != t->ver [1] && u->ver [k] != t->ver [2]) break;
+      ver [3+j] = cache->map [SLOT (idx [(u->ver [k] - yy) / 3], npa)];
+    }
+  }
+
+  cache->nv = nh;
+  cache->npa = npa;
+  cache->npb = npb;
+}
+
+/* record the output triangles (tri, m) with vertices at 'pt' */
+static void cache_triangles (CVICACHE *cache, TRI *tri, int m, double *pt)
+{
+  int *r, j;
+  TRI *t;
+
+  if (cache->tsize < m)
+  {
+    cache->tsize = m;
+    ERRMEM (cache->tri = realloc (cache->tri, sizeof (int [4]) * m));
+  }
+
+  for (t = tri, r = cache->tri; t < tri + m; t ++, r += 4)
+  {
+    r [0] = cache->map [SLOT (t->flg, cache->npa)];
+    for (j = 0; j < 3; j ++) r [1+j] = (t->ver [j] - pt) / 3;
+  }
+
+  cache->m = m;
+}
+
+/* recompute the cached intersection for the current positions of the planes;
+ * each vertex is the pole of a polar hull triangle spanned by three active planes;
+ * NULL is returned when the cached interior point is no longer inside or when
+ * the combinatorial structure of the intersection has changed */
+static TRI* coherent (CVICACHE *cache, double *pa, int npa, double *pb, int npb, CVIKIND kind, ARENA *arena, int *m, double **pv, int *nv)
+{
+  double p [3], e [6], q [3], r [3], n [3], eps, d, *nl, *pt, *x, *y, *a, *b, *c;
+  int i, j, *ver, *s;
+  TRI *tri, *t;
+
+  COPY (cache->p, p);
+
+  /* as in 'intersect': push 'p' deeper inside only if regularized intersection
+   * is sought; otherwise it needs to remain within the contact tolerance */
+  if (kind == REGULARIZED)
+  {
+    if (!refine_point (pa, npa, pb, npb, p, &eps)) return NULL;
+  }
+  else
+  {
+    eps = GEOMETRIC_EPSILON;
+    if (!point_inside (pa, npa, p, eps) || !point_inside (pb, npb, p, eps)) return NULL;
   }
-  for (i = 0, nl = pb, pt = pb + 3; i < npb;
-       i ++, nl += 6, pt += 6, nn += 3)
+
+  /* polar points of the active planes */
+  for (i = 0, y = cache->y; i < cache->nsel; i ++, y += 3)
   {
+    nl = PLANE_OF (cache->sel [i], pa, pb);
+    pt = nl + 3;
     SUB (pt, p, q);
     d = - DOT (nl, q);
-    if (d > -GEOMETRIC_EPSILON) d = -eps; /* regularisation (tiny swelling) */
-    DIV (nl, -d, nn);
+    if (d > -GEOMETRIC_EPSILON) d = -eps;
+    DIV (nl, -d, y);
+  }
+
+  ERRMEM (tri = ARENA_Alloc (arena, sizeof (TRI) * cache->m + sizeof (double [3]) * cache->nv));
+  x = (double*) (tri + cache->m);
+
+  /* vertices: <x, a> = <x, b> = <x, c> = 1 for the polar triangle (a, b, c) */
+  for (i = 0, ver = cache->ver, pt = x; i < cache->nv; i ++, ver += 6, pt += 3)
+  {
+    a = &cache->y [3*ver[0]];
+    b = &cache->y [3*ver[1]];
+    c = &cache->y [3*ver[2]];
+    SUB (b, a, q);
+    SUB (c, a, r);
+    PRODUCT (q, r, n);
+    d = DOT (n, a);
+    if (d <= 0.0) goto error; /* polar triangle flipped */
+    DIV (n, d, pt);
+    ADD (pt, p, pt);
+  }
+
+  /* the polar hull must remain convex across its edges */
+  for (i = 0, ver = cache->ver, pt = x; i < cache->nv; i ++, ver += 6, pt += 3)
+  {
+    for (j = 3; j < 6; j ++)
+    {
+      nl = PLANE_OF (cache->sel [ver [j]], pa, pb);
+      SUB (pt, nl + 3, q);
+      if (DOT (nl, q) > eps * LEN (nl)) goto error;
+    }
   }
 
+  /* the inactive planes must not cut off any vertex */
+  vertices_extents (x, cache->nv, NULL, 0, 0.0, e);
+  if (!vertices_inside (x, cache->nv, e, pa, npa, cache->map, eps) ||
+      !vertices_inside (x, cache->nv, e, pb, npb, cache->map + npa, eps)) goto error;
+
+  for (i = 0, s = cache->tri, t = tri; i < cache->m; i ++, s += 4, t ++)
+  {
+    COPY (PLANE_OF (cache->sel [s[0]], pa, pb), t->out);
+    NORMALIZE (t->out);
+    for (j = 0; j < 3; j ++) t->ver [j] = x + 3*s[1+j];
+    t->flg = cache->sel [s[0]];
+  }
+
+  COPY (p, cache->p);
+  cache->eps = eps;
+  if (pv) *pv = x;
+  if (nv) *nv = cache->nv;
+  *m = cache->m;
+  return tri;
+
+error:
+  if (!arena) free (tri);
+  return NULL;
+}
+
+/* compute convex hull of the polar points (yy, ny), polarise it and triangulate
+ * the polar faces into the intersection surface translated back by 'p'; the 'flg'
+ * of each triangle is set to 'idx' of its polar point; 'e' are the extents of the
+ * input used for a sanity check, whose failure sets '*insane' (if not NULL); when
+ * 'arena' is not NULL the scratch and the output memory are allocated from the arena;
+ * when 'cache' is not NULL the topology of the intersection of 'npa' and 'npb' planes is recorded;
+ * when 'mesh' is not NULL the surface is output there as an indexed mesh (heap allocated) and
+ * NULL is returned, while 'm' is still set to the number of triangles */
+static TRI* polar_surface (double *yy, int ny, int *idx, double *p, double *e, ARENA *arena,
+                           CVICACHE *cache, int npa, int npb, int *m, double **pv, int *nv, int *insane, TRIMESH **mesh)
+{
+  double *nl, *pt, *nn;
+  int i, j, k, l, n, *c;
+  PFV *pfv, *v, *w, *z;
+  TRI *tri, *t, *h;
+  TRIMESH *ms;
+  size_t size;
+
+  tri = NULL;
+  ms = NULL;
+  pfv = NULL;
+  l = 0;
+
   /* compute and polarise convex
    * hull of new normals 'yy' */
-  if (!(tri = hull (yy, npa+npb, &i))) goto error; /* tri = cv (polar (a) U polar (b)) */
-  if (!(pfv = TRI_Polarise (tri, i, &j))) goto error; /* pfv = polar (tri) => pfv = a * b */
+  if (!(h = hull_arena (yy, ny, &i, arena))) goto error; /* h = cv (polar (a) U polar (b)) */
+  if (!(pfv = TRI_Polarise_Arena (h, i, &j, arena))) goto error; /* pfv = polar (h) => pfv = a * b */
+  if (cache) cache_topology (cache, h, i, yy, idx, npa, npb);
 
   /* normals in 'pfv' point to 'yy'; triangulate
    * polar faces and set 'a' or 'b' flags */
@@ -185,8 +526,18 @@ TRI* cvi (double *va, int nva, double *pa, int npa, double *vb, int nvb, double
 #else
   if (n - j*2 <= 3) goto error;
 #endif
-  ERRMEM (tri = realloc (tri, sizeof (TRI) * (n-j*2) + sizeof (double [3]) * i)); /* allocate space for triangles and vertices */
-  pt = (double*) (tri + (n - j*2)); /* this is where output vertices begin */
+  if (mesh) /* the mesh vertex of 'coord' is (coord - nn) / 3, as each polar vertex is used */
+  {
+    ms = TRI_Meshalloc (i, n - j*2);
+    pt = ms->ver;
+  }
+  else
+  {
+    size = sizeof (TRI) * (n-j*2) + sizeof (double [3]) * i; /* space for triangles and vertices */
+    if (arena) { ERRMEM (tri = ARENA_Alloc (arena, size)); }
+    else { ERRMEM (tri = realloc (h, size)); h = NULL; } /* reuse the hull block */
+    pt = (double*) (tri + (n - j*2)); /* this is where output vertices begin */
+  }
   nn = (double*) (pfv + n); /* this is where coords begin in 'pfv' block */
   memcpy (pt, nn, sizeof (double [3]) * i); /* copy vertex data */
   if (pv) *pv = pt;
@@ -200,38 +551,573 @@ TRI* cvi (double *va, int nva, double *pa, int npa, double *vb, int nvb, double
     if (nl[0] < e [0] || nl[1] < e [1] || nl[2] < e [2] ||
 	nl[0] > e [3] || nl[1] > e [4] || nl[2] > e [5])
     {
-#if GEOMDEBUG
-      printf ("CVI HAS GONE INSANE FOR THE INPUT:\n"), dump_input (va, nva, pa, npa, vb, nvb, pb, npb);
-#endif
+      if (insane) *insane = 1;
       goto error;
     }
   }
 
-  for (k = 0, t = tri; k < j; k ++)
+  for (k = 0; k < j; k ++)
   {
     v = &pfv [k]; /* fixed vertex 'v' */
-    for (w = v->n, z = w->n; z != v; w = w->n, z = z->n, t ++) /* remaining vertices 'w' & 'z' */
+    for (w = v->n, z = w->n; z != v; w = w->n, z = z->n, l ++) /* remaining vertices 'w' & 'z' */
     {
-      COPY (v->nl, t->out); /* copy normal */
-      NORMALIZE (t->out);
-      t->ver [0] = pt + (v->coord - nn); /* map vertices */
-      t->ver [1] = pt + (w->coord - nn);
-      t->ver [2] = pt + (z->coord - nn);
-      t->flg = ((v->nl - yy) / 3) + 1; /* first 'npa' entries in 'yy' come from 'a' => positive 1-based index in 'a' */
-      if (t->flg > npa) t->flg = -(t->flg - npa); /* last 'npb' ones come from 'b' => negative 1-based index in 'b' */
+      if (ms)
+      {
+	nl = &ms->nl [3*l];
+	COPY (v->nl, nl);
+	NORMALIZE (nl);
+	c = &ms->tri [3*l];
+	c [0] = (v->coord - nn) / 3;
+	c [1] = (w->coord - nn) / 3;
+	c [2] = (z->coord - nn) / 3;
+	ms->flg [l] = idx [(v->nl - yy) / 3];
+      }
+      else
+      {
+	t = &tri [l];
+	COPY (v->nl, t->out); /* copy normal */
+	NORMALIZE (t->out);
+	t->ver [0] = pt + (v->coord - nn); /* map vertices */
+	t->ver [1] = pt + (w->coord - nn);
+	t->ver [2] = pt + (z->coord - nn);
+	t->flg = idx [(v->nl - yy) / 3];
+      }
     }
   }
 
+  if (ms)
+  {
+    TRI_Meshadj (ms);
+    *mesh = ms;
+  }
+
+  if (cache && tri) cache_triangles (cache, tri, l, pt);
+
   goto done;
 
 error:
-  if (tri) free (tri);
-  tri = t = NULL;
+  if (tri && !arena) free (tri);
+  free (ms);
+  if (cache) cache->nsel = 0;
+  tri = NULL;
+  l = 0;
 
 done:
-  free (yy);
-  free (pfv);
+  if (!arena)
+  {
+    free (pfv);
+    free (h);
+  }
+
+  (*m) = l;
+  return tri;
+}
+
+/* compute intersection of two convex polyhedrons; when 'arena' is not NULL
+ * the scratch and the output memory are allocated from the arena; when 'cache'
+ * is not NULL the topology of a successfully computed intersection is recorded;
+ * when 'mesh' is not NULL the output is an indexed mesh as in 'polar_surface' */
+static TRI* intersect (double *va, int nva, double *pa, int npa, double *vb, int nvb, double *pb, int npb,
+                       CVIKIND kind, ARENA *arena, int *m, double **pv, int *nv, int *culled, CVICACHE *cache, TRIMESH **mesh)
+{
+  double e [6], ea [6], eb [6], x [6], p [3], q [3], eps, d, *yy;
+  int i, ny, *idx, insane;
+  TRI *tri;
+
+  /* initialize */
+  eps = GEOMETRIC_EPSILON;
+
+  if (culled) *culled = 0;
+
+  if (cache) cache->nsel = 0;
+
+  /* compute closest points */
+  d = gjk (va, nva, vb, nvb, p, q);
+  if (d > GEOMETRIC_EPSILON) { *m = 0; return NULL; }
+
+  /* push 'p' deeper inside only if regularized intersection is sought */
+  if (kind == REGULARIZED && !refine_point (pa, npa, pb, npb, p, &eps)) { *m = 0; return NULL; }
+
+  /* vertices extents of 'a' and 'b'; their union is used
+   * for a later sanity check and their intersection 'x',
+   * bounding a * b, is used to cull redundant planes */
+  vertices_extents (va, nva, NULL, 0, eps, ea);
+  vertices_extents (vb, nvb, NULL, 0, eps, eb);
+  for (i = 0; i < 3; i ++)
+  {
+    e [i] = MIN (ea [i], eb [i]);
+    e [i+3] = MAX (ea [i+3], eb [i+3]);
+    x [i] = MAX (ea [i], eb [i]);
+    x [i+3] = MIN (ea [i+3], eb [i+3]);
+  }
+
+  /* translate base points of planes so that p = q = 0
+   * and compute new normals 'yy' of the planes that can
+   * bound the intersection; 'idx' maps them back to 'a' and 'b' */
+  ERRMEM (yy = ARENA_Alloc (arena, (sizeof (double [3]) + sizeof (int)) * (npa+npb)));
+  idx = (int*) (yy + 3 * (npa+npb));
+  ny = polar_vertices (pa, npa, 1, p, eps, x, yy, idx);
+  ny += polar_vertices (pb, npb, -1, p, eps, x, yy + 3*ny, idx + ny);
+  if (ny < 4) /* too few planes left => use all of them */
+  {
+    ny = polar_vertices (pa, npa, 1, p, eps, NULL, yy, idx);
+    ny += polar_vertices (pb, npb, -1, p, eps, NULL, yy + 3*ny, idx + ny);
+  }
+  if (culled) *culled = npa + npb - ny;
+
+  /* triangles 'flg' are set to positive 1-based
+   * indices in 'a' or negative 1-based indices in 'b' */
+  insane = 0;
+  tri = polar_surface (yy, ny, idx, p, e, arena, cache, npa, npb, m, pv, nv, &insane, mesh);
+
+#if GEOMDEBUG
+  if (insane) printf ("CVI HAS GONE INSANE FOR THE INPUT:\n"), dump_input (va, nva, pa, npa, vb, nvb, pb, npb);
+#endif
+
+  if (tri && cache)
+  {
+    COPY (p, cache->p);
+    cache->eps = eps;
+  }
+
+  if (!arena) free (yy);
+
+  return tri;
+}
+
+/* compute intersection of two convex polyhedrons */
+TRI* cvi (double *va, int nva, double *pa, int npa, double *vb, int nvb, double *pb, int npb, CVIKIND kind, int *m, double **pv, int *nv)
+{
+  return intersect (va, nva, pa, npa, vb, nvb, pb, npb, kind, NULL, m, pv, nv, NULL, NULL, NULL);
+}
+
+/* compute intersection of two convex polyhedrons in arena memory */
+TRI* cvi_arena (double *va, int nva, double *pa, int npa, double *vb, int nvb, double *pb, int npb, CVIKIND kind, int *m, double **pv, int *nv, int *culled, ARENA *arena)
+{
+  return intersect (va, nva, pa, npa, vb, nvb, pb, npb, kind, arena, m, pv, nv, culled, NULL, NULL);
+}
+
+/* compute intersection of two convex polyhedrons as an indexed mesh */
+TRIMESH* cvi_mesh (double *va, int nva, double *pa, int npa, double *vb, int nvb, double *pb, int npb, CVIKIND kind)
+{
+  TRIMESH *mesh;
+  int m;
+
+  mesh = NULL;
+
+  intersect (va, nva, pa, npa, vb, nvb, pb, npb, kind, NULL, &m, NULL, NULL, NULL, NULL, &mesh);
+
+  return mesh;
+}
+
+/* compute intersection of 'k' convex polyhedrons */
+TRI* cvi_multi (CVICONVEX *cvx, int k, CVIKIND kind, int *m, double **pv, int *nv, ARENA *arena)
+{
+  double e [6], ec [6], x [6], p [3], eps, *yy;
+  int i, j, l, n, ny, *idx, *off;
+  TRI *tri, *t;
+
+  eps = GEOMETRIC_EPSILON;
+
+  /* common point, pushed deeper inside only if regularized intersection is sought */
+  if (k < 1 || !multi_point (cvx, k, p, arena) ||
+     (kind == REGULARIZED && !refine_multi (cvx, k, p, &eps))) { *m = 0; return NULL; }
+
+  /* union 'e' and intersection 'x' of extents */
+  for (j = n = 0; j < k; j ++)
+  {
+    vertices_extents (cvx[j].v, cvx[j].nv, NULL, 0, eps, ec);
+    for (i = 0; i < 3; i ++)
+    {
+      e [i] = j ? MIN (e [i], ec [i]) : ec [i];
+      e [i+3] = j ? MAX (e [i+3], ec [i+3]) : ec [i+3];
+      x [i] = j ? MAX (x [i], ec [i]) : ec [i];
+      x [i+3] = j ? MIN (x [i+3], ec [i+3]) : ec [i+3];
+    }
+    n += cvx[j].np;
+  }
+
+  /* polar points of all planes that can bound the intersection; 'idx'
+   * stores 0-based plane indices in the concatenation of all plane sets,
+   * while 'off' stores offsets of subsequent plane sets */
+  ERRMEM (yy = ARENA_Alloc (arena, sizeof (double [3]) * n + sizeof (int) * (n+k+1)));
+  idx = (int*) (yy + 3*n);
+  off = idx + n;
+  for (j = off [0] = 0; j < k; j ++) off [j+1] = off [j] + cvx[j].np;
+
+  for (ny = 0, l = 1; l >= 0 && ny < 4; l --) /* with culling first; all planes if too few are left */
+  {
+    for (j = ny = 0; j < k; j ++)
+    {
+      i = polar_vertices (cvx[j].p, cvx[j].np, 1, p, eps, l ? x : NULL, yy + 3*ny, idx + ny);
+      for (i += ny; ny < i; ny ++) idx [ny] += off [j] - 1;
+    }
+  }
+
+  tri = polar_surface (yy, ny, idx, p, e, arena, NULL, 0, 0, m, pv, nv, NULL, NULL);
+
+  /* map plane indices to source polyhedrons and planes */
+  for (t = tri, j = 0; t && t < tri + (*m); t ++)
+  {
+    while (t->flg < off [j]) j --;
+    while (t->flg >= off [j+1]) j ++;
+    t->ptr = cvx[j].p + 6 * (t->flg - off [j]);
+    t->flg = j + 1;
+  }
+
+  if (!arena) free (yy);
 
-  (*m) = (t - tri);
   return tri;
 }
+
+/* volume of the cone with apex at zero over the right triangle in the plane at
+ * distance 'h' (> 0), with the leg 'a' along the foot of the perpendicular and
+ * the angle 't' at the foot, clipped by the ball of radius 'r' centred at zero */
+static double wedge_volume (double h, double a, double r, double t)
+{
+  double s, v, R, tc, g;
+
+  s = t < 0.0 ? -1.0 : 1.0;
+  t = fabs (t);
+  g = h / sqrt (h*h + a*a);
+
+  if (r <= h) v = r*r*r/3.0 * (t - asin (g * sin (t))); /* the ball does not reach the plane */
+  else
+  {
+    R = sqrt (r*r - h*h); /* radius of the ball section in the plane */
+    tc = a < R ? acos (a / R) : 0.0; /* the edge leaves the ball section at 'tc' */
+    v = h*a*a * tan (MIN (t, tc)) / 6.0; /* unclipped part */
+    if (t > tc) v += (h*R*R/6.0 + r*r*h/3.0) * (t - tc) - r*r*r/3.0 * (asin (g * sin (t)) - asin (g * sin (tc))); /* clipped part */
+  }
+
+  return s * v;
+}
+
+/* area and first moment 'mo' (along the leg 'a' and along the edge) of
+ * the right triangle as above, clipped by the disk of radius 'R' */
+static double wedge_area (double a, double R, double t, double *mo)
+{
+  double s, v, tc, t1;
+
+  s = t < 0.0 ? -1.0 : 1.0;
+  t = fabs (t);
+
+  tc = a < R ? acos (a / R) : 0.0;
+  t1 = MIN (t, tc);
+  v = a*a * tan (t1) / 2.0;
+  mo [0] = a*a*a * tan (t1) / 3.0;
+  mo [1] = a*a*a * tan (t1) * tan (t1) / 6.0;
+  if (t > tc)
+  {
+    v += R*R * (t - tc) / 2.0;
+    mo [0] += R*R*R/3.0 * (sin (t) - sin (tc));
+    mo [1] += R*R*R/3.0 * (cos (tc) - cos (t));
+  }
+
+  mo [0] *= s; /* the moment along the edge is even in 't' */
+  return s * v;
+}
+
+/* clip by the ball of radius 'r' centred at zero the cone with apex at zero over
+ * the triangle (a, b, c); return the signed (by the triangle orientation) volume
+ * of the clipped cone and output the triangle unit normal 'n' together with the
+ * area 'area' and the first moment 'mom' of the triangle part inside of the ball */
+static double cone_cut (double *a, double *b, double *c, double r, double *n, double *area, double *mom)
+{
+  double *ver [4], f [3], d [3], g [3], e [3], mp [2], mq [2], h, R, len, ga, tp, tq, s, vol, ar;
+  int i;
+
+  SUB (b, a, d);
+  SUB (c, a, g);
+  PRODUCT (d, g, n);
+  len = LEN (n);
+  *area = 0.0;
+  SET (mom, 0.0);
+  if (len == 0.0) return 0.0;
+  DIV (n, len, n);
+
+  h = DOT (n, a); /* signed distance of the triangle plane from zero */
+  MUL (n, h, f); /* foot of the perpendicular */
+  R = r*r - h*h;
+  R = R > 0.0 ? sqrt (R) : 0.0;
+  ver [0] = a; ver [1] = b; ver [2] = c; ver [3] = a;
+
+  /* decompose the triangle into triangles (f, p, q) over its edges (p, q),
+   * each being a difference of two right triangles along the edge line */
+  for (i = 0, vol = ar = 0.0; i < 3; i ++)
+  {
+    SUB (ver [i+1], ver [i], d);
+    len = LEN (d);
+    if (len == 0.0) continue;
+    DIV (d, len, d); /* edge direction */
+    SUB (ver [i], f, g);
+    tp = DOT (g, d);
+    SUBMUL (g, tp, d, g); /* from the foot to the edge line */
+    ga = LEN (g);
+    if (ga <= GEOMETRIC_EPSILON * len) continue; /* foot on the edge line */
+    DIV (g, ga, g);
+    tq = tp + len;
+    tp = atan2 (tp, ga);
+    tq = atan2 (tq, ga);
+    PRODUCT (g, d, e);
+    s = DOT (e, n) > 0.0 ? 1.0 : -1.0; /* orientation of (f, p, q) */
+
+    if (h != 0.0) vol += s * (wedge_volume (fabs (h), ga, r, tq) - wedge_volume (fabs (h), ga, r, tp));
+
+    if (R > 0.0)
+    {
+      ar += s * (wedge_area (ga, R, tq, mq) - wedge_area (ga, R, tp, mp));
+      ADDMUL (mom, s * (mq [0] - mp [0]), g, mom);
+      ADDMUL (mom, s * (mq [1] - mp [1]), d, mom);
+    }
+  }
+
+  ADDMUL (mom, ar, f, mom); /* moment about zero */
+  *area = ar;
+
+  return h < 0.0 ? -vol : vol;
+}
+
+/* intersect the closed surface (tri, m) with the ellipsoid rot * diag (sca) * B + c,
+ * B being the unit ball, or with the sphere (c, r) for a NULL 'rot'; return the volume
+ * and output the area, the first moment and the area weighted normal of the surface part
+ * inside of the curved body; the computation takes place in the frame of B or of the
+ * sphere centre, where the cones from the centre over the triangles are clipped */
+static double ball_cut (TRI *tri, int m, double *c, double r, double *sca, double *rot, double *area, double *mom, double *nrm)
+{
+  double T [9], S [9], x [3][3], n [3], q [3], mo [3], det, vol, ar, k;
+  TRI *t, *e;
+  int i;
+
+  if (rot)
+  {
+    NNCOPY (rot, T); /* T = rot * diag (sca) */
+    SCALE (T, sca[0]);
+    SCALE (T+3, sca[1]);
+    SCALE (T+6, sca[2]);
+    NNCOPY (rot, S); /* S = inv (T') = rot * diag (1/sca) */
+    SCALE (S, 1.0/sca[0]);
+    SCALE (S+3, 1.0/sca[1]);
+    SCALE (S+6, 1.0/sca[2]);
+    det = sca[0]*sca[1]*sca[2];
+    r = 1.0;
+  }
+  else det = 1.0;
+
+  *area = vol = 0.0;
+  SET (mom, 0.0);
+  SET (nrm, 0.0);
+
+  for (t = tri, e = tri + m; t < e; t ++)
+  {
+    for (i = 0; i < 3; i ++)
+    {
+      SUB (t->ver [i], c, q);
+      if (rot) { TVMUL (S, q, x [i]); } /* x = inv (T) q = diag (1/sca) rot' q */
+      else { COPY (q, x [i]); }
+    }
+
+    vol += cone_cut (x [0], x [1], x [2], r, n, &ar, mo);
+
+    if (ar > 0.0)
+    {
+      if (rot) /* areas of planar parts scale by det |S n| */
+      {
+	NVMUL (S, n, q);
+	k = det * LEN (q);
+	*area += k * ar;
+	ADDMUL (nrm, det * ar, q, nrm);
+	NVMUL (T, mo, x [0]);
+	ADDMUL (x [0], ar, c, x [0]);
+	ADDMUL (mom, k, x [0], mom);
+      }
+      else
+      {
+	ADDMUL (mo, ar, c, mo);
+	ADD (mom, mo, mom);
+	*area += ar;
+	ADDMUL (nrm, ar, n, nrm);
+      }
+    }
+  }
+
+  return det * vol;
+}
+
+/* finalise the contact patch given the closest point 'p' of the polyhedron */
+static void patch_finalise (CVIPATCH *patch, double area, double *mom, double *nrm, double *p)
+{
+  double len;
+
+  patch->area = area;
+  if (area > 0.0) { DIV (mom, area, patch->point); }
+  else { COPY (p, patch->point); }
+  len = LEN (nrm);
+  if (len > 0.0) { DIV (nrm, len, patch->normal); }
+  else { SET (patch->normal, 0.0); }
+}
+
+/* compute intersection volume of a polyhedron and a sphere */
+double cvi_sphere (TRI *tri, int m, double *v, int nv, double *c, double r, CVIPATCH *patch)
+{
+  double p [3], q [3], mom [3], nrm [3], area, vol, d;
+
+  d = gjk_convex_sphere (v, nv, c, r, p, q);
+
+  if (d > GEOMETRIC_EPSILON) /* separated */
+  {
+    if (patch)
+    {
+      SUB (q, p, nrm);
+      patch_finalise (patch, 0.0, NULL, nrm, p);
+    }
+    return 0.0;
+  }
+
+  vol = ball_cut (tri, m, c, r, NULL, NULL, &area, mom, nrm);
+
+  if (patch) patch_finalise (patch, area, mom, nrm, p);
+
+  return vol;
+}
+
+/* compute intersection volume of a polyhedron and an ellipsoid */
+double cvi_ellip (TRI *tri, int m, double *v, int nv, double *c, double *sca, double *rot, CVIPATCH *patch)
+{
+  double p [3], q [3], mom [3], nrm [3], area, vol, d;
+
+  d = gjk_convex_ellip (v, nv, c, sca, rot, p, q);
+
+  if (d > GEOMETRIC_EPSILON) /* separated */
+  {
+    if (patch)
+    {
+      SUB (q, p, nrm);
+      patch_finalise (patch, 0.0, NULL, nrm, p);
+    }
+    return 0.0;
+  }
+
+  vol = ball_cut (tri, m, c, 1.0, sca, rot, &area, mom, nrm);
+
+  if (patch) patch_finalise (patch, area, mom, nrm, p);
+
+  return vol;
+}
+
+/* initialise intersection cache */
+void cvi_cache_init (CVICACHE *cache)
+{
+  cache->sel = cache->map = cache->ver = cache->tri = NULL;
+  cache->y = NULL;
+  cache->nsel = cache->nv = cache->m = 0;
+  cache->npa = cache->npb = 0;
+  cache->size = cache->vsize = cache->tsize = 0;
+  cache->hits = 0;
+  cache->misses = 0;
+}
+
+/* compute intersection of two convex polyhedrons reusing the cached topology */
+TRI* cvi_cached (CVICACHE *cache, double *va, int nva, double *pa, int npa, double *vb, int nvb, double *pb, int npb,
+                 CVIKIND kind, int *m, double **pv, int *nv, ARENA *arena)
+{
+  TRI *tri;
+
+  if (cache->nsel && cache->npa == npa && cache->npb == npb &&
+     (tri = coherent (cache, pa, npa, pb, npb, kind, arena, m, pv, nv)))
+  {
+    cache->hits ++;
+    return tri;
+  }
+
+  cache->misses ++;
+  return intersect (va, nva, pa, npa, vb, nvb, pb, npb, kind, arena, m, pv, nv, NULL, cache, NULL);
+}
+
+/* release intersection cache memory */
+void cvi_cache_free (CVICACHE *cache)
+{
+  free (cache->sel);
+  free (cache->map);
+  free (cache->ver);
+  free (cache->tri);
+  free (cache->y);
+  cvi_cache_init (cache);
+}
+
+/* create batched intersection driver */
+CVIBATCH* cvi_batch_create (int nworkers)
+{
+  CVIBATCH *batch;
+  int i;
+
+  if (nworkers <= 0)
+  {
+#if OPENMP
+    nworkers = omp_get_max_threads ();
+#else
+    nworkers = 1;
+#endif
+  }
+
+  ERRMEM (batch = MEM_CALLOC (sizeof (CVIBATCH)));
+  ERRMEM (batch->arena = MEM_CALLOC (sizeof (ARENA*) * nworkers));
+  for (i = 0; i < nworkers; i ++)
+  {
+    ERRMEM (batch->arena [i] = malloc (sizeof (ARENA))); /* separately allocated => no false sharing */
+    ARENA_Init (batch->arena [i], 0);
+  }
+  batch->nworkers = nworkers;
+
+  return batch;
+}
+
+/* intersect 'n' pairs of convex polyhedrons */
+CVIOUT* cvi_batch (CVIBATCH *batch, CVIPAIR *pair, int n, CVIKIND kind)
+{
+  int i;
+
+  if (n > batch->size)
+  {
+    free (batch->out);
+    ERRMEM (batch->out = malloc (sizeof (CVIOUT) * n));
+    batch->size = n;
+  }
+
+  for (i = 0; i < batch->nworkers; i ++) ARENA_Reset (batch->arena [i]);
+
+#if OPENMP
+  #pragma omp parallel for schedule (dynamic, 16) num_threads (batch->nworkers)
+#endif
+  for (i = 0; i < n; i ++)
+  {
+    CVIPAIR *p = &pair [i];
+    CVIOUT *o = &batch->out [i];
+#if OPENMP
+    ARENA *arena = batch->arena [omp_get_thread_num ()];
+#else
+    ARENA *arena = batch->arena [0];
+#endif
+
+    o->tri = intersect (p->va, p->nva, p->pa, p->npa, p->vb, p->nvb, p->pb, p->npb, kind, arena, &o->m, &o->pv, &o->nv, &o->culled, NULL, NULL);
+    if (!o->tri) o->pv = NULL, o->nv = 0;
+  }
+
+  return batch->out;
+}
+
+/* destroy batched intersection driver */
+void cvi_batch_destroy (CVIBATCH *batch)
+{
+  int i;
+
+  for (i = 0; i < batch->nworkers; i ++)
+  {
+    ARENA_Release (batch->arena [i]);
+    free (batch->arena [i]);
+  }
+
+  free (batch->arena);
+  free (batch->out);
+  free (batch);
+}
@@ -27,6 +27,7 @@
  */
 
 #include "tri.h"
+#include "mem.h"
 
 #ifndef __cvi__
 #define __cvi__
@@ -50,4 +51,126 @@ TRI* cvi (double *va, int nva, double *pa, int npa,
           double *vb, int nvb, double *pb, int npb,
 	  CVIKIND kind, int *m, double **pv, int *nv);
 
+/* as above, but output an indexed mesh (see TRI_Tomesh), with adjacency, straight
+ * from the polar faces (the vertices follow their order rather than the order
+ * of the 'pv' table of 'cvi'); return NULL if the intersection is empty */
+TRIMESH* cvi_mesh (double *va, int nva, double *pa, int npa,
+                   double *vb, int nvb, double *pb, int npb, CVIKIND kind);
+
+/* as 'cvi', but with all scratch and output memory allocated from the 'arena';
+ * the returned table must not be freed and it remains valid until the arena is
+ * reset; reusing one arena across calls (with ARENA_Reset in between) settles
+ * on a single block, after which no heap allocation takes place; a NULL 'arena'
+ * is heap based, as 'cvi'; 'culled' if not NULL returns the number of input
+ * planes culled before the hull computation ('cvi' keeps its signature) */
+TRI* cvi_arena (double *va, int nva, double *pa, int npa,
+                double *vb, int nvb, double *pb, int npb,
+	        CVIKIND kind, int *m, double **pv, int *nv, int *culled, ARENA *arena);
+
+typedef struct cvi_convex CVICONVEX; /* input of the k-way intersection */
+struct cvi_convex
+{
+  double *v; /* vertices (3-vectors) */
+  int nv; /* number of vertices */
+  double *p; /* planes (6-vectors: normal, point) */
+  int np; /* number of planes */
+};
+
+/* compute intersection of 'k' convex polyhedrons 'cvx' in a single polar hull,
+ * with all scratch and output memory allocated from the 'arena' (heap based for
+ * a NULL 'arena'); the 'flg' member in TRI is set to the 1-based index of the source
+ * polyhedron in 'cvx' and the 'ptr' member points to the source plane in its plane
+ * table; the remaining output conventions follow 'cvi'; a common interior point is
+ * sought by cyclic projections, resolved by the running pairwise intersection when
+ * they converge slowly, so that thin overlaps are not reported as empty */
+TRI* cvi_multi (CVICONVEX *cvx, int k, CVIKIND kind, int *m, double **pv, int *nv, ARENA *arena);
+
+typedef struct cvi_patch CVIPATCH; /* contact patch of a polyhedron and a curved body */
+struct cvi_patch
+{
+  double area; /* area of the polyhedron surface inside of the body */
+  double point [3]; /* centroid of that surface, or the closest point of the polyhedron if the area is zero */
+  double normal [3]; /* area weighted outward normal of that surface, or the direction towards the separated
+		        body, normalised; zero when the body is entirely inside of the polyhedron */
+};
+
+/* compute volume of intersection of a polyhedron and a sphere (c, r): (tri, m) is the closed
+ * and outward oriented surface mesh of the polyhedron and (v, nv) are its vertices; the
+ * volume is computed exactly by clipping with the sphere cones from its centre over
+ * the triangles; 'patch' if not NULL returns the contact patch */
+double cvi_sphere (TRI *tri, int m, double *v, int nv, double *c, double r, CVIPATCH *patch);
+
+/* as above, but for an ellipsoid (c, sca, rot) parametrised as in 'gjk_convex_ellip' */
+double cvi_ellip (TRI *tri, int m, double *v, int nv, double *c, double *sca, double *rot, CVIPATCH *patch);
+
+typedef struct cvi_cache CVICACHE; /* per-pair cache of the last intersection */
+struct cvi_cache
+{
+  double p [3], eps; /* last interior point and regularisation */
+  int *sel, nsel; /* signed 1-based indices of active planes of 'a' (positive) and 'b' (negative) */
+  int *map; /* plane slots [0, npa) of 'a' and [npa, npa+npb) of 'b' mapped to 'sel' positions or -1 */
+  int *ver, nv; /* per vertex: three 'sel' planes meeting at it and three 'sel' planes across its polar edges */
+  int *tri, m; /* per triangle: 'sel' position of its plane and three vertex indices */
+  double *y; /* scratch for polar points of the active planes */
+  int npa, npb; /* plane counts of the cached pair */
+  int size, vsize, tsize; /* sizes of the plane, vertex and triangle tables */
+  int hits, misses; /* number of reused and full computations */
+};
+
+/* initialise an empty intersection cache */
+void cvi_cache_init (CVICACHE *cache);
+
+/* compute intersection as 'cvi_arena' (heap based for a NULL 'arena'); first try to
+ * reuse the combinatorial structure of the previous intersection computed with the
+ * same 'cache': the vertices are recomputed from the three active planes meeting at
+ * them and the result is accepted if the active planes remain locally convex and no
+ * other plane cuts off a vertex; otherwise fall back to the complete computation;
+ * the input polyhedrons should keep their plane numbering between the calls */
+TRI* cvi_cached (CVICACHE *cache, double *va, int nva, double *pa, int npa,
+                 double *vb, int nvb, double *pb, int npb,
+	         CVIKIND kind, int *m, double **pv, int *nv, ARENA *arena);
+
+/* release intersection cache memory */
+void cvi_cache_free (CVICACHE *cache);
+
+typedef struct cvi_pair CVIPAIR; /* input pair of convex polyhedrons */
+struct cvi_pair
+{
+  double *va, *pa, *vb, *pb; /* vertices and planes of 'a' and 'b' as in 'cvi' */
+  int nva, npa, nvb, npb;
+  void *data; /* user data (e.g. the pair of boxes reported by 'hybrid') */
+};
+
+typedef struct cvi_output CVIOUT; /* intersection of a pair */
+struct cvi_output
+{
+  TRI *tri; /* 'm' triangles as returned by 'cvi' or NULL if empty */
+  int m;
+  double *pv; /* 'nv' vertices of the intersection */
+  int nv;
+  int culled; /* number of input planes culled before the hull computation */
+};
+
+typedef struct cvi_batch CVIBATCH; /* batched intersection driver */
+struct cvi_batch
+{
+  ARENA **arena; /* per-worker scratch and output memory */
+  int nworkers; /* number of worker threads */
+  CVIOUT *out; /* pair-indexed output */
+  int size; /* size of the 'out' table */
+};
+
+/* create batched intersection driver for 'nworkers' threads
+ * (nworkers <= 0 selects the default number of threads) */
+CVIBATCH* cvi_batch_create (int nworkers);
+
+/* intersect 'n' pairs; the returned table is indexed as 'pair' and is independent
+ * of the thread scheduling; the output memory belongs to the worker arenas and
+ * remains valid until the next call, hence it should not be freed by the caller;
+ * the workers run in parallel when compiled with OPENMP=yes */
+CVIOUT* cvi_batch (CVIBATCH *batch, CVIPAIR *pair, int n, CVIKIND kind);
+
+/* destroy batched intersection driver */
+void cvi_batch_destroy (CVIBATCH *batch);
+
 #endif
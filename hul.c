@@ -30,12 +30,17 @@
  */
 
 #include <stdlib.h>
+#include <string.h>
 #include <float.h>
+#if OPENMP
+#include <omp.h>
+#endif
 #include "mem.h"
 #include "err.h"
 #include "alg.h"
 #include "lis.h"
 #include "set.h"
+#include "map.h"
 #include "hul.h"
 #include "predicates.h"
 
@@ -59,22 +64,83 @@ struct edge
 struct face
 {
   double pla [4];
+  double per [3]; /* permanents of the 'pla' normal => error bound of the filtered orientation */
   vertex *v, *w; /* list of facial vertices 'v' and the furthest vertex 'w' */
   edge *e; /* list of edges (and implicitly, the list of neighbours */
   face *n; /* next face in a list */
+  face *lp, *ln; /* previous and next face in the list of pending or final faces */
+  face *vn; /* next visible face */
   char marked; /* marker used for visible faces */
   TRI *tri; /* auxiliary adjacent triangle (used to create the output table) */
+  int index; /* output triangle index (used to create the output mesh) */
+  int heap; /* position in the heap of pending faces or -1 */
+  double dist; /* distance of the furthest vertex 'w' (the heap key) */
 };
 
-/* robust orientation */
-static double orient (face *f, double *d)
+struct hull_object
 {
-  double *a, *b, *c;
+  MEM mv, me, mf; /* vertex, edge and face pools */
+  face todo, done; /* sentinels of the lists of faces with nonempty and empty vertex lists */
+  int n; /* number of points inserted so far (bounds the walks around vertices) */
+  long orient, exact; /* number of orientation tests and of those resolved by 'orient3d' */
+  face **heap; /* max-heap of pending faces by their furthest vertex distance or NULL if not used */
+  int nheap, sheap; /* heap size and capacity */
+};
+
+/* relative error bound of the filtered orientation */
+#define ORIENT_BOUND (5.0 * DBL_EPSILON)
+
+/* initialise exact arithmetic used by 'orient3d' (once); hulls may be computed
+ * concurrently (e.g. by 'cvi_batch' workers), hence the guarded initialisation */
+static void exact_init (void)
+{
+  static int done = 0;
+  int ready;
+
+#if OPENMP
+  #pragma omp atomic read seq_cst
+#endif
+  ready = done;
+
+  if (!ready)
+  {
+#if OPENMP
+    #pragma omp critical (exact_init)
+#endif
+    {
+      if (!done)
+      {
+	exactinit ();
+#if OPENMP
+	#pragma omp atomic write seq_cst
+#endif
+	done = 1;
+      }
+    }
+  }
+}
+
+/* robust orientation: the face plane is used unless 'd' is within its rounding error
+ * bound from it, in which case Shewchuk's exact 'orient3d' is called; both return a
+ * positive value (proportional to the distance) for 'd' above the face */
+static double orient (HULL *hl, face *f, double *d)
+{
+  double *a, *b, *c, x [3], o, err;
   edge *e1, *e2;
 
   e1 = f->e;
-  e2 = e1->n;
   a = e1->v[0];
+  SUB (d, a, x);
+  o = DOT (f->pla, x);
+  err = ORIENT_BOUND * (f->per [0] * fabs (x [0]) + f->per [1] * fabs (x [1]) + f->per [2] * fabs (x [2]));
+
+  if (hl) hl->orient ++;
+
+  if (o > err || o < -err) return o;
+
+  if (hl) hl->exact ++;
+
+  e2 = e1->n;
   b = e1->v[1];
   c = e2->v[1];
 
@@ -92,6 +158,9 @@ static int setplane (face *f)
   SUB (e2->v[1], e2->v[0], cb);
   PRODUCT (ba, cb, f->pla);
   f->pla [3] = - DOT (e1->v[0], f->pla);
+  f->per [0] = fabs (ba [1] * cb [2]) + fabs (ba [2] * cb [1]);
+  f->per [1] = fabs (ba [2] * cb [0]) + fabs (ba [0] * cb [2]);
+  f->per [2] = fabs (ba [0] * cb [1]) + fabs (ba [1] * cb [0]);
 
   MAXABS (f->pla, ba [0]);
   if (ba [0] == 0.0) return 0; /* degenerate case (colinear vertices) */
@@ -242,25 +311,24 @@ static int vcmp (double **a, double **b)
   else return 1; 
 }
 
-/* select vertices of an initial simplex and output the list of remaining vertices */
-static int simplex_vertices (double *v, int n, MEM *mv, double *sv [4], vertex **out)
+/* select vertices of an initial simplex and output the list of remaining vertices;
+ * 'pv' are pointers to the 'n' input points (the table is used as scratch memory) */
+static int simplex_vertices (double **pv, int n, MEM *mv, double *sv [4], vertex **out, ARENA *arena)
 {
-  double **pv, **pp, **pq, **pe, **pn;
+  double **pp, **pq, **pe, **pn;
   double d, a[3], b[3], c[3], u[3];
   SET *points, *item;
   MEM setmem;
   vertex *x;
   int i, j;
 
-  ERRMEM (pv = MEM_CALLOC (sizeof (double*) * n));
-  MEM_Init (&setmem, sizeof (SET), n);
+  MEM_Init_Arena (&setmem, sizeof (SET), n, arena);
   points = NULL;
   *out = NULL;
 
-  for (pp = pv, pe = pv+n; pp < pe; pp ++, v += 3)
+  for (pp = pv, pe = pv+n; pp < pe; pp ++)
   {
-    SET_Insert (&setmem, &points, v, NULL); /* set of all input points */
-    *pp = v; /* vector of pointers to all input points */
+    SET_Insert (&setmem, &points, *pp, NULL); /* set of all input points */
   }
 
   /* sort input points along the first coordinate */
@@ -337,7 +405,6 @@ static int simplex_vertices (double *v, int n, MEM *mv, double *sv [4], vertex *
   if (j != 4)
   {
     MEM_Release (&setmem);
-    free (pv);
     return 0;
   }
 #endif
@@ -351,7 +418,6 @@ static int simplex_vertices (double *v, int n, MEM *mv, double *sv [4], vertex *
   }
 
   MEM_Release (&setmem);
-  free (pv);
   return 1;
 }
 
@@ -454,7 +520,7 @@ static face* simplex (MEM *me, MEM *mf, double *a, double *b, double *c, double
 #else
     if (!setplane (f[i])) return NULL; /* set face plane */
 #endif
-    if (orient (f[i], o [i]) > 0.0) /* the other vertex should be behind => reorient the face */
+    if (orient (NULL, f[i], o [i]) > 0.0) /* the other vertex should be behind => reorient the face */
     {
       for (edg = f[i]->e; edg; edg = edg->n) /* reverse order of edge vertices */
       { u = edg->v [0]; edg->v [0] = edg->v [1]; edg->v [1] = u; }
@@ -473,19 +539,37 @@ static face* simplex (MEM *me, MEM *mf, double *a, double *b, double *c, double
   return f [0];
 }
 
-/* mark faces visible from 'v'ertex */
-static void mark (face *f, double *v, face **g)
+/* mark faces visible from 'v'ertex and collect them in the 'vis' list */
+static void mark (HULL *hl, face *f, double *v, face **g, face **vis)
 {
-  double d = orient (f, v);
+  double d = orient (hl, f, v);
     
   if (!f->marked && d > 0.0)
   {
     f->marked = 1;
-    for (edge *e = f->e; e; e = e->n) mark (e->f, v, g);
+    f->vn = *vis;
+    *vis = f;
+    for (edge *e = f->e; e; e = e->n) mark (hl, e->f, v, g, vis);
   }
   else if (d <= 0.0) *g = f;
 }
 
+/* insert face after the list sentinel 'l' */
+inline static void face_link (face *l, face *f)
+{
+  f->lp = l;
+  f->ln = l->ln;
+  l->ln->lp = f;
+  l->ln = f;
+}
+
+/* remove face from its list */
+inline static void face_unlink (face *f)
+{
+  f->lp->ln = f->ln;
+  f->ln->lp = f->lp;
+}
+
 /* return next CCW face after f around vertx v */
 inline static face* nextaround (face *f, double *v)
 {
@@ -559,229 +643,1183 @@ static int testsimplex (face *h)
   return 1;
 }
 
-/* compute convex hull */
-TRI* hull (double *v, int n, int *m)
+/* assign to face 'f' the vertices from list 'l' that are above it, selecting
+ * the furthest one (so far) as 'f->w'; assigned vertices are removed from 'l' */
+static void assign (HULL *hl, face *f, vertex **l)
 {
-  face *f, *g, *h, *head, *cur, *tail;
-  edge *e, *k, *i, *j, *ehead, *etail;
-  double d, dmax, *sv [4];
-  vertex *x, *y, *z, *l;
-  MEM mv, me, mf;
-  TRI *tri, *t;
+  vertex *x, *y, *z;
+  double d, dmax;
 
-  MEM_Init (&mv, sizeof (vertex), n);
-  MEM_Init (&me, sizeof (edge), n);
-  MEM_Init (&mf, sizeof (face), n);
-  tri = NULL;
+  dmax = f->w ? orient (hl, f, f->w->v) : 0.0;
+
+  for (z = NULL, x = *l; x; x = y)
+  {
+    y = x->n; 
+    d = orient (hl, f, x->v);
+    if (d > 0.0)
+    {
+      if (d > dmax) /* and select maximal elements */
+      {
+	dmax = d;
+	if (f->w)
+	{ f->w->n = f->v;
+	  f->v = f->w; } /* move to the regular list */
+	f->w = x; /* set as maximal */
+      }
+      else /* insert into the regular list */
+      { x->n = f->v;
+	f->v = x; }
+
+      /* update 'l' list */	  
+      if (z) z->n = y; /* skip one */
+      else *l = y; /* update head */
+    }
+    else z = x; /* previous element staying in the list */
+  }
+}
+
+/* initialise hull with the initial simplex of the 'n' points pointed by 'pv'
+ * (the table is used as scratch memory); the remaining points are assigned
+ * to outside vertex lists of the simplex faces; return 0 on failure */
+static int hull_start (HULL *hl, double **pv, int n, ARENA *arena)
+{
+  double *sv [4];
+  face *f, *g, *h;
+  vertex *l;
+
+  MEM_Init_Arena (&hl->mv, sizeof (vertex), n, arena);
+  MEM_Init_Arena (&hl->me, sizeof (edge), n, arena);
+  MEM_Init_Arena (&hl->mf, sizeof (face), n, arena);
+  hl->todo.ln = hl->todo.lp = &hl->todo; /* faces with nonempty vertex lists */
+  hl->done.ln = hl->done.lp = &hl->done; /* faces with empty vertex lists */
+  hl->n = n;
+  hl->orient = hl->exact = 0;
+  hl->heap = NULL;
+  hl->nheap = hl->sheap = 0;
 
   /* select vertices of an initial simplex into 'sv' */
-  if (!simplex_vertices (v, n, &mv, sv, &l)) goto error;
+  if (!simplex_vertices (pv, n, &hl->mv, sv, &l, arena)) return 0;
  
   /* create the initial simplex */ 
-  if (!(h = simplex (&me, &mf, sv[0], sv[1], sv[2], sv[3]))) goto error;
+  if (!(h = simplex (&hl->me, &hl->mf, sv[0], sv[1], sv[2], sv[3]))) return 0;
 
-  if (!(testsimplex (h))) goto error;
+  if (!(testsimplex (h))) return 0;
 
   /* initialise outside vertex lists */
-  for (f = h; f; f = f->n)
+  for (f = h; f; f = f->n) assign (hl, f, &l);
+
+  for (f = h; f; f = g) /* sort faces into the pending and the final lists */
+  {
+    g = f->n;
+    face_link (f->w ? &hl->todo : &hl->done, f);
+  }
+
+  return 1;
+}
+
+/* signed distance of 'x' from the plane of face 'f' */
+inline static double distance (face *f, double *x)
+{
+  return (DOT (f->pla, x) + f->pla [3]) / LEN (f->pla);
+}
+
+/* restore the order of the heap of pending faces at position 'i' */
+static void heap_fix (HULL *hl, int i)
+{
+  face **h = hl->heap, *f;
+  int j;
+
+  for (; i > 0 && h [(i-1)/2]->dist < h [i]->dist; i = j) /* up */
+  {
+    j = (i-1)/2;
+    f = h [i]; h [i] = h [j]; h [j] = f;
+    h [i]->heap = i; h [j]->heap = j;
+  }
+
+  for (; (j = 2*i+1) < hl->nheap; i = j) /* down */
+  {
+    if (j+1 < hl->nheap && h [j+1]->dist > h [j]->dist) j ++;
+    if (h [j]->dist <= h [i]->dist) break;
+    f = h [i]; h [i] = h [j]; h [j] = f;
+    h [i]->heap = i; h [j]->heap = j;
+  }
+}
+
+/* insert a pending face into the heap */
+static void heap_insert (HULL *hl, face *f)
+{
+  if (hl->nheap == hl->sheap)
+  {
+    hl->sheap = 2 * hl->sheap + 64;
+    ERRMEM (hl->heap = realloc (hl->heap, sizeof (face*) * hl->sheap));
+  }
+
+  f->dist = distance (f, f->w->v);
+  f->heap = hl->nheap;
+  hl->heap [hl->nheap ++] = f;
+  heap_fix (hl, f->heap);
+}
+
+/* remove a face from the heap (if it is there) */
+static void heap_remove (HULL *hl, face *f)
+{
+  int i = f->heap;
+
+  if (i < 0) return;
+
+  f->heap = -1;
+
+  if (i < -- hl->nheap)
+  {
+    hl->heap [i] = hl->heap [hl->nheap];
+    hl->heap [i]->heap = i;
+    heap_fix (hl, i);
+  }
+}
+
+/* add the furthest outside point of pending face 'f' to the hull; return 0 on failure */
+static int hull_step (HULL *hl, face *f)
+{
+  face *g, *head, *cur, *tail, *vis;
+  edge *e, *k, *i, *j, *ehead, *etail;
+  vertex *x, *y;
+
+  /* mark visible faces */
+  vis = NULL;
+  mark (hl, f, f->w->v, &g, &vis);
+
+  /* loop over the ridge edges */
+  if (!g || !(k = e = nextonridge (hl->n, g->e, NULL))) return 0;
+  ehead = etail = NULL;
+  head = tail = NULL;
+  do
+  {
+    /* create new face */
+    ERRMEM (cur = MEM_Alloc (&hl->mf));
+    if (!tail) tail = cur; /* record last face */
+    ERRMEM (i = MEM_Alloc (&hl->me));
+    i->v [0] = e->v [1]; /* first new edge is adjacent to 'e' => reversed */
+    i->v [1] = e->v [0];
+    i->f = g; /* first new edge is the neighbour of 'g' */
+    cur->e = i; /* include the edge into the new face's edge list */
+    ERRMEM (j = MEM_Alloc (&hl->me));
+    j->v [0] = f->w->v; /* this is the top vertes */
+    j->v [1] = e->v [1];
+    j->n = cur->e; cur->e = j; /* maintain edge list */
+    ERRMEM (i = MEM_Alloc (&hl->me));
+    i->v [0] = e->v [0];
+    i->v [1] = f->w->v; /* top vertex */
+    i->n = cur->e; cur->e = i; /* maintain edge list */
+
+    if (head) /* if there are already new faces in the list */
+    { i->f = head; /* this edge's neighbour is the list head */
+      ehead->f = cur; } /* and head's edge neighbour is the current face */
+    else etail = i; /* or => set up tail's edge (to be connected at the end) */
+
+    cur->n = head; head = cur; /* maintain face list */
+    ehead = j; /* this is the head edge */
+    
+    j = e; /* back up current outer edge => 'nextonridge' needs an old 'e->f' */
+    if (!(e = nextonridge (hl->n, j, &g))) return 0; /* next outer edge along the visible set ridge */
+    j->f = cur; /* set up new adjacency (once the old 'e->f' was utilised) */
+
+  } while (e != k);
+  /* link tail and head */
+  ehead->f = tail;
+  etail->f = head;
+
+  /* free top vertex */
+  MEM_Free (&hl->mv, f->w);
+  f->w = NULL;
+
+  /* for each new face */
+  for (g = head; g; g = g->n)
   {
-    for (z = NULL, x = l, dmax = 0.0; x; x = y)
+    if (!setplane (g)) /* set up g->pla (returnes 0 if a degenerate triangle was found)  */
     {
-      y = x->n; 
-      d = orient (f, x->v);
-      if (d > 0.0)
-      {
-	if (d > dmax) /* and select maximal elements */
-	{
-	  if (f->w)
-	  { f->w->n = f->v;
-	    f->v = f->w; } /* move to the regular list */
-	  f->w = x; /* set as maximal */
-	}
-	else /* insert into the regular list */
-	{ x->n = f->v;
-	  f->v = x; }
+      if (!mendface (g)) return 0; /* vertices are colinear but not coincident (that case was eliminated by sorting and filtering) */
+    }
+  }
+
+  /* for each marked face f */
+  for (f = vis; f; f = f->vn)
+  {
+    if (f->w)
+    { f->w->n = f->v; /* put the furthest vertex 'w' back into the 'v' list */
+      f->v = f->w; }
+
+    if (f->v)
+    {
+      /* for each new face g */
+      for (g = head; g; g = g->n) assign (hl, g, &f->v); /* move vertices above 'g' from 'f->v' */
+    }
+  }
+
+  /* for each marked face f */
+  for (f = vis; f; f = g)
+  {
+    g = f->vn;
+    face_unlink (f);
+
+    /* delete all v in f->v */
+    for (x = f->v; x; x = y)
+    { y = x->n; MEM_Free (&hl->mv, x); }
+
+    /* delete all e in f->e */
+    for (e = f->e; e; e = i)
+    { i = e->n; MEM_Free (&hl->me, e); }
+
+    /* delete f */
+    if (hl->heap) heap_remove (hl, f);
+    MEM_Free (&hl->mf, f);
+  }
+
+  /* sort the new faces into
+   * the pending and the final lists */
+  for (f = head; f; f = g)
+  {
+    g = f->n;
+    face_link (f->w ? &hl->todo : &hl->done, f);
+    if (hl->heap) { f->heap = -1; if (f->w) heap_insert (hl, f); }
+  }
+
+  return 1;
+}
+
+/* process pending faces until all outside vertex lists are empty; return 0 on failure */
+static int hull_expand (HULL *hl)
+{
+  face *f;
+
+  while ((f = hl->todo.ln) != &hl->todo) /* first face with a nonempty vertex list */
+  {
+    if (!hull_step (hl, f)) return 0;
+  }
+
+  return 1;
+}
+
+/* translate final faces into a table of 'm' triangles */
+static TRI* hull_output (HULL *hl, int *m, ARENA *arena)
+{
+  edge *e, *k, *i;
+  TRI *tri, *t;
+  face *f;
+
+  for (f = hl->done.ln; f != &hl->done; f = f->ln) f->tri = NULL;
+
+  /* 'done' contains faces of the convex hull;
+   * it be now translated into a table TRI[] */
+
+  for ((*m) = 0, f = hl->done.ln; f != &hl->done; f = f->ln) (*m) ++; /* count output faces */
+  ERRMEM (tri = ARENA_Alloc (arena, (*m) * sizeof (TRI))); /* output memory (faces are triangular) */
+  memset (tri, 0, (*m) * sizeof (TRI));
+  for (t = tri, f = hl->done.ln; f != &hl->done; f = f->ln, t ++) /* translate each face into a triangle */
+  {
+    e = f->e; k = e->n; i = k->n;
+    COPY (f->pla, t->out); /* same normal */
+    t->ver [0] = e->v [0]; /* CCW ordered vertices */
+    t->ver [1] = k->v [0];
+    t->ver [2] = i->v [0];
+#if GEOMDEBUG
+    if (e->f->tri) { ASSERT_DEBUG (TRI_Addadj (e->f->tri, t), "Too many triangle neighbours"); } /* called only once for each pair => after (***) ... */
+    if (k->f->tri) { ASSERT_DEBUG (TRI_Addadj (k->f->tri, t), "Too many triangle neighbours"); }
+    if (i->f->tri) { ASSERT_DEBUG (TRI_Addadj (i->f->tri, t), "Too many triangle neighbours"); }
+#else
+    if (e->f->tri) if (!TRI_Addadj (e->f->tri, t)) { if (!arena) free (tri); return NULL; } /* called only once for each pair => after (***) ... */
+    if (k->f->tri) if (!TRI_Addadj (k->f->tri, t)) { if (!arena) free (tri); return NULL; }
+    if (i->f->tri) if (!TRI_Addadj (i->f->tri, t)) { if (!arena) free (tri); return NULL; }
+#endif
+    f->tri = t; /* ... (***) has been executed for the first of neighbours */
+  }
+
+  for (t --; t >= tri; t --) TRI_Sortadj (t); /* sort adjacency lists */
+
+  return tri;
+}
+
+/* translate final faces into an indexed mesh of the referenced points of (v, n) */
+static TRIMESH* hull_output_mesh (HULL *hl, double *v, int n)
+{
+  int i, j, k, nt, *map;
+  TRIMESH *mesh;
+  double *x;
+  edge *e;
+  face *f;
+
+  ERRMEM (map = malloc (sizeof (int) * n));
+  for (i = 0; i < n; i ++) map [i] = -1;
+
+  /* number the faces and the vertices they reference */
+  for (nt = k = 0, f = hl->done.ln; f != &hl->done; f = f->ln, nt ++)
+  {
+    f->index = nt;
+    for (e = f->e; e; e = e->n)
+    {
+      i = (e->v [0] - v) / 3;
+      if (map [i] < 0) map [i] = k ++;
+    }
+  }
+
+  mesh = TRI_Meshalloc (k, nt);
+
+  for (i = 0; i < n; i ++)
+  {
+    if (map [i] >= 0) { x = &mesh->ver [3*map[i]]; COPY (&v [3*i], x); }
+  }
+
+  /* edge 'e' leads from the triangle corner 'j' to 'j+1' and the face
+   * behind it is the neighbour through that edge, as in TRI_Meshadj */
+  for (f = hl->done.ln; f != &hl->done; f = f->ln)
+  {
+    for (e = f->e, j = 3 * f->index; e; e = e->n, j ++)
+    {
+      mesh->tri [j] = map [(e->v [0] - v) / 3];
+      mesh->adj [j] = e->f->index;
+    }
+    x = &mesh->nl [3 * f->index];
+    COPY (f->pla, x);
+    NORMALIZE (x);
+    mesh->flg [f->index] = 0;
+  }
+
+  free (map);
+
+  return mesh;
+}
+
+/* release hull memory */
+static void hull_release (HULL *hl)
+{
+  MEM_Release (&hl->mv);
+  MEM_Release (&hl->me);
+  MEM_Release (&hl->mf);
+  free (hl->heap);
+  hl->heap = NULL;
+}
+
+/* compute convex hull of points pointed by 'pv' (the table is used as scratch memory);
+ * the work memory comes from the 'scratch' arena and the output from the 'arena' */
+static TRI* quickhull (double **pv, int n, int *m, ARENA *scratch, ARENA *arena, HULLSTATS *stats)
+{
+  TRI *tri;
+  HULL hl;
+
+  tri = NULL;
+
+  if (hull_start (&hl, pv, n, scratch) && hull_expand (&hl)) tri = hull_output (&hl, m, arena);
+
+  if (stats)
+  {
+    stats->faces = tri ? *m : 0;
+    stats->orient = hl.orient;
+    stats->exact = hl.exact;
+  }
+
+  hull_release (&hl);
+
+  return tri;
+}
+
+/* Akl-Toussaint filtering: copy into 'pv' pointers to those of the 'n' points 'v' that are
+ * not strictly inside of the hull of their extremes along the axes and diagonals (any
+ * point strictly inside of it can not be a hull vertex); return the number of copied points */
+static int extreme_filter (double *v, int n, double **pv, ARENA *scratch)
+{
+  double dir [14][3] = {{1,0,0}, {-1,0,0}, {0,1,0}, {0,-1,0}, {0,0,1}, {0,0,-1},
+                        {1,1,1}, {-1,-1,-1}, {1,1,-1}, {-1,-1,1}, {1,-1,1}, {-1,1,-1}, {-1,1,1}, {1,-1,-1}};
+  double *ext [14], sup [14], pla [4][HULL_FILTER_FACES], u [3], *x, *end, d, len, tol;
+  int i, j, k, m;
+  TRI *tri, *t;
+
+  for (j = 0; j < 14; j ++) { ext [j] = v; sup [j] = DOT (dir [j], v); }
+
+  for (x = v + 3, end = v + 3*n; x < end; x += 3) /* extreme points */
+  {
+    for (j = 0; j < 14; j ++)
+    {
+      d = DOT (dir [j], x);
+      if (d > sup [j]) { sup [j] = d; ext [j] = x; }
+    }
+  }
+
+  for (j = k = 0; j < 14; j ++) /* a point can be extreme in several directions */
+  {
+    for (i = 0; i < k; i ++) if (ext [i] == ext [j] || (ext [i][0] == ext [j][0] &&
+      ext [i][1] == ext [j][1] && ext [i][2] == ext [j][2])) break;
+    if (i == k) ext [k ++] = ext [j];
+  }
+
+  tri = k < 4 ? NULL : quickhull (ext, k, &m, scratch, scratch, NULL);
+
+  if (!tri || m > HULL_FILTER_FACES) /* degenerate extremes */
+  {
+    if (!scratch) free (tri);
+    for (i = 0, x = v; i < n; i ++, x += 3) pv [i] = x;
+    return n;
+  }
+
+  for (t = tri, tol = 0.0, k = 0; t < tri + m; t ++, k ++) /* unit outward planes */
+  {
+    len = LEN (t->out);
+    DIV (t->out, len, u);
+    pla [0][k] = u [0];
+    pla [1][k] = u [1];
+    pla [2][k] = u [2];
+    pla [3][k] = - DOT (u, t->ver [0]);
+  }
+  for (j = 0; j < 6; j ++) tol = MAX (tol, fabs (sup [j])); /* coordinates scale */
+  tol *= GEOMETRIC_EPSILON;
+  if (!scratch) free (tri);
+
+  for (i = k = 0, x = v; i < n; i ++, x += 3)
+  {
+    for (j = 0, d = -DBL_MAX; j < m; j ++) /* maximal distance (vectorisable) */
+    {
+      len = pla [0][j] * x [0] + pla [1][j] * x [1] + pla [2][j] * x [2] + pla [3][j];
+      d = MAX (d, len);
+    }
+
+    if (d >= -tol) pv [k ++] = x; /* not strictly inside */
+  }
+
+  return k;
+}
+
+/* compute convex hull */
+TRI* hull (double *v, int n, int *m)
+{
+  return hull_stats (v, n, m, NULL, NULL);
+}
+
+/* compute convex hull using arena memory */
+TRI* hull_arena (double *v, int n, int *m, ARENA *arena)
+{
+  return hull_stats (v, n, m, arena, NULL);
+}
+
+/* compute convex hull with scratch memory from 'scratch' and output memory from 'arena' */
+static TRI* filtered_hull (double *v, int n, int *m, ARENA *scratch, ARENA *arena, HULLSTATS *stats)
+{
+  double **pv, *x;
+  TRI *tri;
+  int k;
+
+  exact_init ();
+
+  ERRMEM (pv = ARENA_Alloc (scratch, sizeof (double*) * n));
+
+  if (n >= HULL_FILTER_MIN) k = extreme_filter (v, n, pv, scratch);
+  else for (k = 0, x = v; k < n; k ++, x += 3) pv [k] = x;
+
+  if (stats)
+  {
+    stats->input = n;
+    stats->dropped = n - k;
+    stats->ratio = n ? (double) (n - k) / (double) n : 0.0;
+    stats->faces = 0;
+    stats->orient = stats->exact = 0;
+  }
+
+  tri = quickhull (pv, k, m, scratch, arena, stats);
+
+  if (!scratch) free (pv);
+
+  return tri;
+}
+
+/* compute convex hull as an indexed mesh */
+TRIMESH* hull_mesh (double *v, int n)
+{
+  TRIMESH *mesh;
+  double **pv, *x;
+  HULL hl;
+  int k;
+
+  exact_init ();
+
+  ERRMEM (pv = malloc (sizeof (double*) * n));
+
+  if (n >= HULL_FILTER_MIN) k = extreme_filter (v, n, pv, NULL);
+  else for (k = 0, x = v; k < n; k ++, x += 3) pv [k] = x;
+
+  mesh = NULL;
+
+  /* the mesh is output straight from the final faces */
+  if (hull_start (&hl, pv, k, NULL) && hull_expand (&hl)) mesh = hull_output_mesh (&hl, v, n);
+
+  hull_release (&hl);
+  free (pv);
+
+  return mesh;
+}
+
+/* compute convex hull and its statistics */
+TRI* hull_stats (double *v, int n, int *m, ARENA *arena, HULLSTATS *stats)
+{
+  return filtered_hull (v, n, m, arena, arena, stats);
+}
+
+struct hull_workspace
+{
+  ARENA scratch; /* point tables, sets and pools of the last call */
+};
+
+/* create hull workspace */
+HULLWORK* hull_work_create (void)
+{
+  HULLWORK *work;
+
+  ERRMEM (work = malloc (sizeof (HULLWORK)));
+  ARENA_Init (&work->scratch, 0);
 
-        /* update 'l' list */	  
-	if (z) z->n = y; /* skip one */
-	else l = y; /* update head */
+  return work;
+}
+
+/* compute convex hull using workspace memory */
+TRI* hull_work (HULLWORK *work, double *v, int n, int *m, ARENA *arena)
+{
+  ARENA_Reset (&work->scratch); /* pools of the last call are dropped at once */
+
+  return filtered_hull (v, n, m, &work->scratch, arena, NULL);
+}
+
+/* destroy hull workspace */
+void hull_work_destroy (HULLWORK *work)
+{
+  ARENA_Release (&work->scratch);
+  free (work);
+}
+
+/* create incremental hull */
+HULL* hull_create (double *v, int n)
+{
+  double **pv;
+  HULL *hl;
+  int k;
+
+  exact_init ();
+
+  ERRMEM (hl = malloc (sizeof (HULL)));
+  ERRMEM (pv = malloc (sizeof (double*) * n));
+
+  if (n >= HULL_FILTER_MIN) k = extreme_filter (v, n, pv, NULL);
+  else for (k = 0; k < n; k ++) pv [k] = &v [3*k];
+
+  if (!(hull_start (hl, pv, k, NULL) && hull_expand (hl)))
+  {
+    hull_release (hl);
+    free (hl);
+    hl = NULL;
+  }
+
+  free (pv);
+
+  return hl;
+}
+
+/* find a face visible from 'x': the walk from 'f' crosses edges separating 'x' from the face
+ * in the cones spanned by the hull faces at the inner point 'o' and ends in the face whose cone
+ * contains 'x', which is then visible or 'x' is inside; all faces are tested when 'o' is NULL */
+static face* visible (HULL *hl, face *f, double *o, double *x)
+{
+  edge *e;
+  int i;
+
+  for (i = 0; o && i <= 2 * hl->n + 4; i ++) /* at most as many steps as faces */
+  {
+    for (e = f->e; e; e = e->n)
+    {
+      if (orient3d (o, e->v[0], e->v[1], x) > 0.0) break; /* 'x' is beyond this edge */
+    }
+
+    if (!e) return orient (hl, f, x) > 0.0 ? f : NULL;
+
+    f = e->f;
+  }
+
+  for (f = hl->done.ln; f != &hl->done; f = f->ln) /* test all */
+  {
+    if (orient (hl, f, x) > 0.0) return f;
+  }
+
+  return NULL;
+}
+
+/* outside point and its visible face */
+typedef struct { double *p; face *g; } outside;
+
+static int ocmp (outside *a, outside *b)
+{
+  return vcmp (&a->p, &b->p);
+}
+
+/* insert points into incremental hull */
+int hull_insert (HULL *hl, double *v, int n)
+{
+  double c [3], q [3], r, d, *p;
+  outside *out;
+  face *f, *g;
+  vertex *x;
+  edge *e;
+  int i, j, k;
+
+  /* a ball inside of the hull, used to skip
+   * inner points: centred at the mean of face
+   * vertices and touching the nearest plane */
+  SET (c, 0.0);
+  for (i = 0, f = hl->done.ln; f != &hl->done; f = f->ln, i ++)
+  {
+    ADD (c, f->e->v [0], c);
+  }
+  DIV (c, (double) i, c);
+  for (r = DBL_MAX, f = hl->done.ln; f != &hl->done; f = f->ln)
+  {
+    d = - distance (f, c);
+    r = MIN (r, d);
+  }
+  r = r > 0.0 ? r * r * (1.0 - GEOMETRIC_EPSILON) : 0.0;
+
+  ERRMEM (out = malloc (sizeof (outside) * MAX (n, 1)));
+
+  for (i = k = 0, f = hl->done.ln, p = v; i < n; i ++, p += 3)
+  {
+    SUB (p, c, q);
+    if (DOT (q, q) < r) continue; /* inside of the ball */
+
+    if ((g = visible (hl, f, r > 0.0 ? c : NULL, p)))
+    {
+      for (e = g->e; e; e = e->n)
+      {
+	SUB (p, e->v[0], q);
+	MAXABS (q, d);
+	if (d < 20.0 * GEOMETRIC_EPSILON) break; /* as in 'simplex_vertices' */
       }
-      else z = x; /* previous element staying in the list */
-    }
-  }
-
-  for (f = h; f && (!f->w); f = f->n); /* find first face with a nonempty vertex list */
-  while (f)
-  {
-    /* mark visible faces */
-    mark (f, f->w->v, &g);
-
-    /* loop over the ridge edges */
-    if (!g || !(k = e = nextonridge (n, g->e, NULL))) goto error;
-    ehead = etail = NULL;
-    head = tail = NULL;
-    do
-    {
-      /* create new face */
-      ERRMEM (cur = MEM_Alloc (&mf));
-      if (!tail) tail = cur; /* record last face */
-      ERRMEM (i = MEM_Alloc (&me));
-      i->v [0] = e->v [1]; /* first new edge is adjacent to 'e' => reversed */
-      i->v [1] = e->v [0];
-      i->f = g; /* first new edge is the neighbour of 'g' */
-      cur->e = i; /* include the edge into the new face's edge list */
-      ERRMEM (j = MEM_Alloc (&me));
-      j->v [0] = f->w->v; /* this is the top vertes */
-      j->v [1] = e->v [1];
-      j->n = cur->e; cur->e = j; /* maintain edge list */
-      ERRMEM (i = MEM_Alloc (&me));
-      i->v [0] = e->v [0];
-      i->v [1] = f->w->v; /* top vertex */
-      i->n = cur->e; cur->e = i; /* maintain edge list */
-
-      if (head) /* if there are already new faces in the list */
-      { i->f = head; /* this edge's neighbour is the list head */
-        ehead->f = cur; } /* and head's edge neighbour is the current face */
-      else etail = i; /* or => set up tail's edge (to be connected at the end) */
-
-      cur->n = head; head = cur; /* maintain face list */
-      ehead = j; /* this is the head edge */
-      
-      j = e; /* back up current outer edge => 'nextonridge' needs an old 'e->f' */
-      if (!(e = nextonridge (n, j, &g))) goto error; /* next outer edge along the visible set ridge */
-      j->f = cur; /* set up new adjacency (once the old 'e->f' was utilised) */
+      if (e) continue; /* near-duplicate of a hull vertex */
+
+      out [k].p = p;
+      out [k ++].g = g;
+      f = g; /* next walk starts here */
+    }
+  }
+
+  /* drop near-duplicates among the outside points */
+  qsort (out, k, sizeof (outside), (int (*)(const void*, const void*))ocmp);
+
+  for (i = 0; i < k; i ++)
+  {
+    if (!out [i].g) continue;
+
+    for (j = i + 1; j < k && out [j].p [0] - out [i].p [0] < 20.0 * GEOMETRIC_EPSILON; j ++)
+    {
+      SUB (out [j].p, out [i].p, q);
+      MAXABS (q, d);
+      if (d < 20.0 * GEOMETRIC_EPSILON) out [j].g = NULL;
+    }
+
+    ERRMEM (x = MEM_Alloc (&hl->mv)); /* assign outside vertex */
+    x->v = out [i].p;
+    assign (hl, out [i].g, &x);
+  }
+
+  free (out);
+
+  for (f = hl->done.ln; f != &hl->done; f = g) /* move faces with outside vertices to the pending list */
+  {
+    g = f->ln;
+    if (f->w)
+    {
+      face_unlink (f);
+      face_link (&hl->todo, f);
+    }
+  }
+
+  hl->n += n;
+
+  return hull_expand (hl);
+}
+
+/* export incremental hull */
+TRI* hull_tri (HULL *hl, int *m)
+{
+  return hull_output (hl, m, NULL);
+}
+
+/* destroy incremental hull */
+void hull_destroy (HULL *hl)
+{
+  hull_release (hl);
+  free (hl);
+}
+
+/* compute convex hull in parallel */
+/* flag vertices of the hull of the chunk 'i' out of 'nchunks' of 'n' points 'v' */
+static void chunk_hull (double *v, int n, int i, int nchunks, char *flag)
+{
+  int j, k, mc;
+  TRI *tri, *t;
+
+  j = (int) ((long) n * i / nchunks);
+  k = (int) ((long) n * (i+1) / nchunks);
+
+  if ((tri = hull (v + 3*j, k - j, &mc)))
+  {
+    for (t = tri; t < tri + mc; t ++)
+    {
+      flag [(t->ver [0] - v) / 3] = 1;
+      flag [(t->ver [1] - v) / 3] = 1;
+      flag [(t->ver [2] - v) / 3] = 1;
+    }
+    free (tri);
+  }
+  else memset (flag + j, 1, k - j); /* degenerate chunk => keep all of its points */
+}
+
+TRI* hull_parallel (double *v, int n, int *m, int nchunks)
+{
+  double *cv, *x;
+  int i, j, k, nc, *map;
+  char *flag;
+  TRI *tri, *t;
 
-    } while (e != k);
-    /* link tail and head */
-    ehead->f = tail;
-    etail->f = head;
+  if (nchunks <= 0)
+  {
+#if OPENMP
+    nchunks = 4 * omp_get_max_threads ();
+#else
+    nchunks = 1;
+#endif
+  }
+  nchunks = MIN (nchunks, n / HULL_CHUNK_MIN);
+
+  if (nchunks <= 1) return hull (v, n, m);
+
+  exact_init (); /* before the threads start */
+
+  ERRMEM (flag = calloc (n, 1));
+
+  /* hulls of chunks; their vertices are
+   * the only candidates for the final hull */
+  chunk_hull (v, n, 0, nchunks, flag); /* the first chunk is a probe */
+
+  for (i = nc = 0, k = (int) ((long) n / nchunks); i < k; i ++) nc += flag [i];
+
+  if (2 * nc > k) /* most points are kept => the final hull would redo all the work */
+  {
+    free (flag);
+    return hull (v, n, m);
+  }
+
+#if OPENMP
+  #pragma omp parallel for schedule (dynamic, 1)
+#endif
+  for (i = 1; i < nchunks; i ++) chunk_hull (v, n, i, nchunks, flag);
+
+  for (i = nc = 0; i < n; i ++) nc += flag [i];
+
+  ERRMEM (cv = malloc (sizeof (double [3]) * nc + sizeof (int) * nc));
+  map = (int*) (cv + 3*nc);
 
-    /* free top vertex */
-    MEM_Free (&mv, f->w);
-    f->w = NULL;
+  for (i = j = 0, x = cv; i < n; i ++)
+  {
+    if (flag [i])
+    {
+      COPY (&v[3*i], x);
+      map [j ++] = i;
+      x += 3;
+    }
+  }
+
+  /* final hull with vertices mapped back to 'v' */
+  if ((tri = hull (cv, nc, m)))
+  {
+    for (t = tri; t < tri + (*m); t ++)
+    {
+      for (i = 0; i < 3; i ++) t->ver [i] = v + 3 * map [(t->ver [i] - cv) / 3];
+    }
+  }
+
+  free (flag);
+  free (cv);
+
+  return tri;
+}
 
-    /* for each new face */
-    for (g = head; g; g = g->n)
+/* merge coplanar neighbours of a hull triangulation into convex polygons */
+HULLPOLY* hull_merge (TRI *tri, int m, double tol)
+{
+  double ext [6], s [3], n [3], *a, *b, *x, **vtab, d, eps;
+  int i, j, k, l, f, h, nf, nv, nk, nl, top, *list, *loop, *offs, *corner, *next, *cnt, *idx, *seed;
+  HULLPOLY *poly;
+  MAP *vm, *im;
+  TRI *t, *q, *e;
+  MEM mem;
+
+  e = tri + m;
+
+  /* consecutive indices of vertices */
+  MEM_Init (&mem, sizeof (MAP), 3*m);
+  for (vm = NULL, nv = 0, t = tri; t < e; t ++)
+  {
+    for (i = 0; i < 3; i ++)
     {
-      if (!setplane (g)) /* set up g->pla (returnes 0 if a degenerate triangle was found)  */
+      if (!MAP_Find_Node (vm, t->ver [i], NULL))
       {
-        if (!mendface (g)) goto error; /* vertices are colinear but not coincident (that case was eliminated by sorting and filtering) */
+	MAP_Insert (&mem, &vm, t->ver [i], (void*) (long) nv, NULL);
+	nv ++;
       }
     }
+  }
+
+  ERRMEM (vtab = malloc (sizeof (double*) * nv + sizeof (int) * (m + 3*m + 3*m + m + 1 + nv + nv + nv + m)));
+  list = (int*) (vtab + nv); /* triangles of the current polygon */
+  loop = list + m; /* boundary loops of all polygons */
+  corner = loop + 3*m; /* vertex indices of triangle corners */
+  offs = corner + 3*m; /* loop offsets */
+  next = offs + m + 1; /* next CCW boundary vertex */
+  cnt = next + nv; /* number of loops passing through a vertex */
+  idx = cnt + nv; /* output vertex indices */
+  seed = idx + nv; /* seed triangles of polygons */
+
+  ext [0] = ext [1] = ext [2] = DBL_MAX;
+  ext [3] = ext [4] = ext [5] = -DBL_MAX;
+  for (im = MAP_First (vm); im; im = MAP_Next (im))
+  {
+    x = im->key;
+    vtab [(int) (long) im->data] = x;
+    for (i = 0; i < 3; i ++)
+    {
+      ext [i] = MIN (ext [i], x [i]);
+      ext [3+i] = MAX (ext [3+i], x [i]);
+    }
+  }
+  SUB (ext+3, ext, s);
+  eps = tol * LEN (s); /* relative to the diameter */
+
+  for (t = tri; t < e; t ++)
+  {
+    t->flg = -1;
+    for (i = 0; i < 3; i ++) corner [3*(t-tri)+i] = (int) (long) MAP_Find (vm, t->ver [i], NULL);
+  }
 
-    /* for each marked face f */
-    for (f = h; f; f = f->n)
+  MEM_Release (&mem);
+
+  for (i = 0; i < nv; i ++) { next [i] = -1; cnt [i] = 0; }
+
+  for (t = tri, nf = nl = 0; t < e; t ++)
+  {
+    if (t->flg >= 0) continue;
+
+    /* grow a polygon from a seed triangle: a neighbour
+     * joins if its vertices are 'eps' close to the seed plane */
+    COPY (t->out, s);
+    NORMALIZE (s);
+    d = DOT (s, t->ver [0]);
+    t->flg = nf;
+    list [0] = seed [nf] = t - tri;
+    top = 1;
+
+    for (h = 0; h < top; h ++)
     {
-      if (f->marked)
+      for (i = 0, t = tri + list [h]; i < 3; i ++)
       {
-	if (f->w)
-	{ f->w->n = f->v; /* put the furthest vertex 'w' back into the 'v' list */
-	  f->v = f->w; }
+	q = t->adj [i];
 
-	if (f->v)
+	if (q && q->flg < 0 &&
+	    fabs (DOT (s, q->ver [0]) - d) <= eps &&
+	    fabs (DOT (s, q->ver [1]) - d) <= eps &&
+	    fabs (DOT (s, q->ver [2]) - d) <= eps)
 	{
-	  /* for each new face g */
-	  for (g = head; g; g = g->n)
-	  {
-	    /* for each v in f->v */
-	    for (dmax = 0.0, l = NULL, x = f->v; x; x = y)
-	    {
-	      y = x->n;
-
-	      d = orient (g, x->v);
-	      if (d > 0.0) /* x is above g->pla */
-	      {
-		if (d > dmax) /* and is maximal */
-		{
-		  if (g->w)
-		  { g->w->n = g->v;
-		    g->v = g->w; } /* move to the regular list */
-		  g->w = x; /* set as maximal */
-		}
-		else /* insert into the regular list */
-		{ x->n = g->v;
-		  g->v = x; }
-
-		if (l) l->n = y; /* x is removed from f->v */
-		else f->v = y;
-	      }
-	      else l = x; /* last not moved vertex */
-	    }
-	  }
+	  q->flg = nf;
+	  list [top ++] = q - tri;
 	}
       }
     }
+    t = tri + list [0];
 
-    /* for each marked face f */
-    for (f = h, h = NULL; f; f = g)
+    /* link boundary edges */
+    for (h = k = 0, j = -1; h < top; h ++)
     {
-      g = f->n;
-      if (f->marked)
+      for (i = 0, q = tri + list [h]; i < 3; i ++)
       {
-        /* delete all v in f->v */
-	for (x = f->v; x; x = y)
-	{ y = x->n; MEM_Free (&mv, x); }
+	if (!q->adj [i] || q->adj [i]->flg != nf)
+	{
+	  j = corner [3*list[h]+i];
+	  next [j] = corner [3*list[h]+(i+1)%3];
+	  k ++;
+	}
+      }
+    }
 
-        /* delete all e in f->e */
-	for (e = f->e; e; e = i)
-	{ i = e->n; MEM_Free (&me, e); }
+    /* walk the CCW loop */
+    offs [nf] = nl;
+    for (l = 0; j >= 0 && next [j] >= 0 && l < k; l ++)
+    {
+      loop [nl ++] = j;
+      cnt [j] ++;
+      i = next [j];
+      next [j] = -1;
+      j = i;
+    }
+
+#if GEOMDEBUG
+    ASSERT_DEBUG (l == k, "A merged hull face is not bounded by a single loop");
+#endif
+
+    if (l < k) /* clear links left over by a non-simple boundary */
+    {
+      for (h = 0; h < top; h ++)
+	for (i = 0; i < 3; i ++) next [corner [3*list[h]+i]] = -1;
+    }
 
-        /* delete f */
-	MEM_Free (&mf, f);
+    nf ++;
+  }
+  offs [nf] = nl;
+
+  /* only vertices shared by three or more polygons are polyhedron
+   * corners; the rest lie within faces or along edges */
+  for (i = nk = 0; i < nv; i ++) idx [i] = cnt [i] >= 3 ? nk ++ : -1;
+  for (i = k = 0; i < nl; i ++) k += idx [loop [i]] >= 0;
+
+  ERRMEM (poly = malloc (sizeof (HULLPOLY) + sizeof (double [6]) * nf + sizeof (double [3]) * nk + sizeof (int) * (nf + 1 + k)));
+  poly->pla = (double*) (poly + 1);
+  poly->ver = poly->pla + 6*nf;
+  poly->face = (int*) (poly->ver + 3*nk);
+  poly->loop = poly->face + nf + 1;
+  poly->nf = nf;
+  poly->nv = nk;
+
+  for (i = 0; i < nv; i ++)
+  {
+    if (idx [i] >= 0) { x = poly->ver + 3*idx[i]; COPY (vtab [i], x); }
+  }
+
+  for (f = k = 0; f < nf; f ++)
+  {
+    if (offs [f] == offs [f+1]) /* no boundary: all triangles are within 'eps' of the seed plane */
+    {
+      t = tri + seed [f];
+      COPY (t->out, n);
+      NORMALIZE (n);
+      a = t->ver [0];
+    }
+    else
+    {
+      /* Newell normal of the whole boundary loop */
+      SET (n, 0.0);
+      for (h = offs [f]; h < offs [f+1]; h ++)
+      {
+	a = vtab [loop [h]];
+	b = vtab [loop [h+1 < offs [f+1] ? h+1 : offs [f]]];
+	n [0] += (a [1] - b [1]) * (a [2] + b [2]);
+	n [1] += (a [2] - b [2]) * (a [0] + b [0]);
+	n [2] += (a [0] - b [0]) * (a [1] + b [1]);
       }
-      else /* output unmarked faces */
+      NORMALIZE (n);
+
+      /* the plane passes through the outermost loop vertex */
+      for (h = offs [f], a = vtab [loop [h]], d = DOT (n, a); h < offs [f+1]; h ++)
       {
-	f->n = h;
-	h = f;
+	x = vtab [loop [h]];
+	if (DOT (n, x) > d) { d = DOT (n, x); a = x; }
       }
     }
+    x = poly->pla + 6*f;
+    COPY (n, x);
+    COPY (a, x+3);
 
-    /* append h with
-     * the new faces */
-    tail->n = h;
-    h = head;
-   
-    /* select next face with nonempty vertex list */ 
-    for (f = h; f && (!f->w); f = f->n);
+    poly->face [f] = k;
+    for (h = offs [f]; h < offs [f+1]; h ++)
+    {
+      if (idx [loop [h]] >= 0) poly->loop [k ++] = idx [loop [h]];
+    }
   }
+  poly->face [nf] = k;
 
-  /* h contains faces of the convex hull;
-   * it be now translated into a table TRI[] */
+  free (vtab);
+
+  return poly;
+}
+
+/* compute convex hull and output its polygonal faces */
+HULLPOLY* hull_polygons (double *v, int n, double tol)
+{
+  HULLPOLY *poly;
+  TRI *tri;
+  int m;
+
+  if (!(tri = hull (v, n, &m))) return NULL;
+
+  poly = hull_merge (tri, m, tol);
+
+  free (tri);
+
+  return poly;
+}
+
+/* maximal gauge (x - c) . y, over polar points 'y' of the triangles of a hull, of a point 'x';
+ * this is a linear function maximised over the vertices of the polar polyhedron, hence a walk
+ * from 't' towards larger values finds the maximum, as long as the flat regions (coplanar
+ * triangles) are crossed; these are searched breadth first, with triangles marked by 'stamp' */
+static double gauge (TRI *tri, double *y, TRI *t, double *x, double *c, int *stamp, TRI **stack)
+{
+  double d [3], g, h, eps;
+  TRI *s, *q, *r;
+  int i, top;
 
-  for ((*m) = 0, f = h; f; f = f->n) (*m) ++; /* count output faces */
-  ERRMEM (tri = MEM_CALLOC ((*m) * sizeof (TRI))); /* output memory (faces are triangular) */
-  for (t = tri, f = h; f; f = f->n, t ++) /* translate each face into a triangle */
+  SUB (x, c, d);
+  g = DOT (y + 3*(t - tri), d);
+
+  do
   {
-    e = f->e; k = e->n; i = k->n;
-    COPY (f->pla, t->out); /* same normal */
-    t->ver [0] = e->v [0]; /* CCW ordered vertices */
-    t->ver [1] = k->v [0];
-    t->ver [2] = i->v [0];
-#if GEOMDEBUG
-    if (e->f->tri) { ASSERT_DEBUG (TRI_Addadj (e->f->tri, t), "Too many triangle neighbours"); } /* called only once for each pair => after (***) ... */
-    if (k->f->tri) { ASSERT_DEBUG (TRI_Addadj (k->f->tri, t), "Too many triangle neighbours"); }
-    if (i->f->tri) { ASSERT_DEBUG (TRI_Addadj (i->f->tri, t), "Too many triangle neighbours"); }
-#else
-    if (e->f->tri) if (!TRI_Addadj (e->f->tri, t)) goto error; /* called only once for each pair => after (***) ... */
-    if (k->f->tri) if (!TRI_Addadj (k->f->tri, t)) goto error;
-    if (i->f->tri) if (!TRI_Addadj (i->f->tri, t)) goto error;
-#endif
-    f->tri = t; /* ... (***) has been executed for the first of neighbours */
+    eps = 1E-12 * fabs (g);
+    t->flg = ++ (*stamp);
+    stack [0] = t;
+    top = 1;
+    s = NULL;
+
+    while (top && !s)
+    {
+      r = stack [-- top];
+      for (i = 0; i < 3; i ++)
+      {
+	if (!(q = r->adj [i]) || q->flg == *stamp) continue;
+	h = DOT (y + 3*(q - tri), d);
+	if (h > g + eps) { g = h; s = q; break; } /* uphill */
+	else if (h >= g - eps) { q->flg = *stamp; stack [top ++] = q; } /* flat */
+      }
+    }
+
+    t = s;
+  } while (t);
+
+  return g;
+}
+
+/* enclose the points left outside of the approximate hull (tri, m) in its copy scaled about the
+ * mass center; the points are listed by the final faces of 'hl', which point to the triangles */
+static TRI* enclose (HULL *hl, TRI *tri, int m)
+{
+  double c [3], d [3], s, g, *y, *z, *x, *e;
+  int stamp;
+  TRI *out, *t, **stack;
+  vertex *p;
+  face *f;
+
+  TRI_Char (tri, m, c);
+
+  ERRMEM (y = malloc (sizeof (double [3]) * m + sizeof (TRI*) * m));
+  stack = (TRI**) (y + 3*m);
+
+  for (t = tri, z = y; t < tri + m; t ++, z += 3) /* polar points */
+  {
+    COPY (t->out, z);
+    g = DOT (z, t->ver [0]) - DOT (z, c);
+    DIV (z, g, z);
+    t->flg = 0;
   }
 
-  for (t --; t >= tri; t --) TRI_Sortadj (t); /* sort adjacency lists */
-  
-  goto done; /* skip error handling */
+  for (s = 1.0, stamp = 0, f = hl->done.ln; f != &hl->done; f = f->ln)
+  {
+    if (f->w && (g = gauge (tri, y, f->tri, f->w->v, c, &stamp, stack)) > s) s = g;
+
+    for (p = f->v; p; p = p->n)
+    {
+      if ((g = gauge (tri, y, f->tri, p->v, c, &stamp, stack)) > s) s = g;
+    }
+  }
 
-error:
- if (tri) free (tri); 
- tri = NULL;
+  out = TRI_Copy (tri, m);
 
-done:
-  /* clean up */
-  MEM_Release (&mv);
-  MEM_Release (&me);
-  MEM_Release (&mf);
+  if (s > 1.0)
+  {
+    s *= 1.0 + 4.0 * DBL_EPSILON;
+
+    for (t = out, e = NULL; t < out + m; t ++)
+    {
+      e = MAX (e, t->ver [0]);
+      e = MAX (e, t->ver [1]);
+      e = MAX (e, t->ver [2]);
+    }
+
+    for (x = (double*) (out + m); x <= e; x += 3) /* vertices follow the triangles */
+    {
+      SUB (x, c, d);
+      ADDMUL (c, s, d, x);
+    }
+  }
+
+  for (t = out; t < out + m; t ++) t->flg = 0;
+
+  free (y);
+
+  return out;
+}
 
+/* compute approximate convex hull */
+TRI* hull_approx (double *v, int n, int k, double tol, int conservative, int *m)
+{
+  double **pv, *x;
+  TRI *tri, *out;
+  face *f;
+  HULL hl;
+  int i, j;
+
+  exact_init ();
+
+  ERRMEM (pv = malloc (sizeof (double*) * n));
+
+  if (n >= HULL_FILTER_MIN) j = extreme_filter (v, n, pv, NULL);
+  else for (j = 0, x = v; j < n; j ++, x += 3) pv [j] = x;
+
+  tri = NULL;
+
+  if (!hull_start (&hl, pv, j, NULL)) goto done;
+
+  if (k > 0) /* pending faces in a max-heap keyed by their furthest point distance */
+  {
+    for (f = hl.done.ln; f != &hl.done; f = f->ln) f->heap = -1;
+    for (f = hl.todo.ln; f != &hl.todo; f = f->ln) heap_insert (&hl, f);
+  }
+
+  for (i = 4; hl.todo.ln != &hl.todo; i ++) /* 'i' bounds the number of vertices */
+  {
+    if (k > 0) /* the furthest point among all pending faces */
+    {
+      f = hl.heap [0];
+
+      if (f->dist <= tol || i >= k) break;
+    }
+    else
+    {
+      f = hl.todo.ln;
+
+      if (distance (f, f->w->v) <= tol) /* close enough => final */
+      {
+	face_unlink (f);
+	face_link (&hl.done, f);
+	i --;
+	continue;
+      }
+    }
+
+    if (!hull_step (&hl, f)) goto done;
+  }
+
+  while ((f = hl.todo.ln) != &hl.todo) /* remaining pending faces are final */
+  {
+    face_unlink (f);
+    face_link (&hl.done, f);
+  }
+
+  if (!(tri = hull_output (&hl, m, NULL)) || !conservative) goto done;
+
+  out = enclose (&hl, tri, *m);
+  free (tri);
+  tri = out;
+
+done:
+  hull_release (&hl);
+  free (pv);
   return tri;
 }
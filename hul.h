@@ -30,14 +30,121 @@
  */
 
 #include "tri.h"
+#include "mem.h"
 
 #ifndef __hul__
 #define __hul__
 
+typedef struct hull_object HULL; /* incremental hull */
+
+typedef struct hull_stats HULLSTATS; /* hull statistics */
+struct hull_stats
+{
+  int input; /* number of input points */
+  int dropped; /* number of points dropped by the Akl-Toussaint pre-filter */
+  double ratio; /* dropped / input */
+  int faces; /* number of output triangles */
+  long orient; /* number of orientation tests */
+  long exact; /* number of orientation tests not resolved by the floating point filter */
+};
+
+/* minimal number of points filtered against the hull of their axis and diagonal extremes */
+#define HULL_FILTER_MIN 64
+
+/* maximal number of faces of the hull of extremes */
+#define HULL_FILTER_FACES 24
+
 /* take n 'v'ertices and output m elements of the doubly connected edge list;
  * note that in the returend table of triangles of size 'm' all vertices point
  * to the memory in 'v'; return NULL if hull creation failed from geometrical
  * reasons; throw memory exception when out of memory */
 TRI* hull (double *v, int n, int *m);
 
+/* as above, but all scratch and output memory is allocated from the 'arena';
+ * the returned table must not be freed and it remains valid until the arena
+ * is reset; a NULL 'arena' is equivalent to calling 'hull' */
+TRI* hull_arena (double *v, int n, int *m, ARENA *arena);
+
+/* as above, also returning statistics if 'stats' is not NULL */
+TRI* hull_stats (double *v, int n, int *m, ARENA *arena, HULLSTATS *stats);
+
+/* as 'hull', but output an indexed mesh (see TRI_Tomesh) referencing copies
+ * of the hull vertices, straight from the final hull faces, so that the mesh
+ * equals TRI_Tomesh (hull (v, n, &m), m, v, n); return NULL on geometrical failure */
+TRIMESH* hull_mesh (double *v, int n);
+
+typedef struct hull_workspace HULLWORK; /* reusable hull workspace */
+
+/* create a workspace whose scratch memory (point tables, vertex, edge and face pools)
+ * persists across 'hull_work' calls, so that repeated hulls cause no heap allocation */
+HULLWORK* hull_work_create (void);
+
+/* as 'hull_arena', but with the scratch memory taken from the workspace (reset on entry),
+ * and the output memory taken from the 'arena' (or from the heap if 'arena' is NULL) */
+TRI* hull_work (HULLWORK *work, double *v, int n, int *m, ARENA *arena);
+
+/* destroy hull workspace */
+void hull_work_destroy (HULLWORK *work);
+
+/* create an incremental hull of 'n' points 'v'; the hull keeps pointers to the
+ * input points, which hence must remain valid until the hull is destroyed;
+ * return NULL if hull creation failed from geometrical reasons */
+HULL* hull_create (double *v, int n);
+
+/* insert 'n' points 'v' (kept by pointers as above) into the hull; only the faces
+ * visible from the points outside of the hull are updated; return 0 if the update
+ * failed from geometrical reasons, after which the hull should be destroyed */
+int hull_insert (HULL *hl, double *v, int n);
+
+/* export the current hull as a table of 'm' triangles in the same form as returned by 'hull' */
+TRI* hull_tri (HULL *hl, int *m);
+
+/* destroy incremental hull */
+void hull_destroy (HULL *hl);
+
+/* minimal number of points in a chunk of 'hull_parallel' */
+#define HULL_CHUNK_MIN 4096
+
+/* as 'hull', but the points are split into 'nchunks' (4 per OpenMP thread or 1 for
+ * nchunks <= 0) chunks whose hulls are computed concurrently, after which the hull
+ * of their vertices is returned; only the chunk hulls are parallel: the final hull
+ * of the surviving vertices is computed sequentially by 'hull' (there is no parallel
+ * merge), so the speed-up relies on the chunk hulls discarding most interior points;
+ * the first chunk is hence hulled alone as a probe and if it keeps more than half of
+ * its points (e.g. points on a sphere) 'hull' of all points is returned instead;
+ * the output table is of the same form as that of 'hull', although the triangulation
+ * of coplanar facets may differ */
+TRI* hull_parallel (double *v, int n, int *m, int nchunks);
+
+typedef struct hull_polygons HULLPOLY; /* polygonal hull */
+struct hull_polygons
+{
+  double *pla; /* unique face planes of size (double [6]) x nf, each (unit normal, point) */
+  double *ver; /* unique vertices of size (double [3]) x nv */
+  int *face; /* face 'i' vertices are loop [face [i]], ..., loop [face [i+1]-1] */
+  int *loop; /* CCW vertex loops of all faces */
+  int nf, nv;
+};
+
+/* merge coplanar neighbours of a hull triangulation (tri, m), with adjacency as returned
+ * by 'hull', into convex polygons; a triangle joins a face when all of its vertices are
+ * within 'tol' x hull diameter from the plane of the face seed triangle; vertices inside
+ * of faces or along their edges are dropped; the polygon (pla, nf) and (ver, nv) tables
+ * can be passed as the plane and vertex inputs of 'cvi' and 'gjk'; the returned continuous
+ * block should be freed by the caller; NOTE => tri->flg is set to the face index */
+HULLPOLY* hull_merge (TRI *tri, int m, double tol);
+
+/* as above, for the hull of 'n' points 'v'; return NULL if hull creation failed */
+HULLPOLY* hull_polygons (double *v, int n, double tol);
+
+/* approximate hull of 'n' points 'v' with at most 'k' vertices (unbounded for k <= 0,
+ * while 0 < k < 4 still yields the initial simplex of 4 vertices), not expanded towards
+ * points within distance 'tol' from it; with k > 0 the furthest point is added first
+ * (pending faces are kept in a heap keyed by the distance of their furthest point);
+ * the output is of the same form as that of 'hull', with points left outside of it,
+ * unless 'conservative' is set, in which case it is scaled about
+ * its mass center just enough to enclose all points (the vertices are then placed right
+ * after the returned table); return NULL if hull creation failed from geometrical reasons */
+TRI* hull_approx (double *v, int n, int k, double tol, int conservative, int *m);
+
 #endif
@@ -36,31 +36,8 @@
 #include "err.h"
 #include "hyb.h"
 
-static int compare0 (double **x, double **y)
-{
-  if (x [0][0] < y [0][0]) return -1;
-  else if (x [0][0] > y [0][0]) return 1;
-  else return 0;
-}
-
-static int compare1 (double **x, double **y)
-{
-  if (x [0][1] < y [0][1]) return -1;
-  else if (x [0][1] > y [0][1]) return 1;
-  else return 0;
-}
-
-static int compare2 (double **x, double **y)
-{
-  if (x [0][2] < y [0][2]) return -1;
-  else if (x [0][2] > y [0][2]) return 1;
-  else return 0;
-}
-
-static int (*qcmp [3]) (const void*, const void*) =
-{(int (*) (const void*, const void*)) compare0,
- (int (*) (const void*, const void*)) compare1,
- (int (*) (const void*, const void*)) compare2};
+/* traversal stack size; deeper trees use heap stacks */
+#define KDT_STACK 64
 
 static void overlap (void *data, BOX *one, BOX *two)
 {
@@ -127,74 +104,149 @@ static int separate (int n, double **q, double epsilon)
   return m;
 }
 
-/* split points along most elongated direction */
-static int split (int n, double **q, double *p, int *d)
+/* nodes with more points are created as parallel tasks */
+#define TASK_SIZE 4096
+
+/* reorder q so that q [k] holds the k-th smallest coordinate 'd' (nth element selection) */
+static void nth (double **q, int n, int k, int d)
 {
-  double extents [6] = {q[0][0], q[0][1], q[0][2], q[0][0], q[0][1], q[0][2]};
-  double **x, **y;
-  int i, j, k, t [2];
+  int lo = 0, hi = n - 1, i, j;
+  double v, *x;
 
-  for (x = q+1, y = q+n; x != y; x ++)
+  while (lo < hi)
   {
-    if (x [0][0] < extents [0]) extents [0] = x [0][0];
-    if (x [0][1] < extents [1]) extents [1] = x [0][1];
-    if (x [0][2] < extents [2]) extents [2] = x [0][2];
-    if (x [0][0] > extents [3]) extents [3] = x [0][0];
-    if (x [0][1] > extents [4]) extents [4] = x [0][1];
-    if (x [0][2] > extents [5]) extents [5] = x [0][2];
+    i = lo + (hi - lo) / 2; /* median of three pivot */
+    if (q[i][d] < q[lo][d]) { x = q[i]; q[i] = q[lo]; q[lo] = x; }
+    if (q[hi][d] < q[lo][d]) { x = q[hi]; q[hi] = q[lo]; q[lo] = x; }
+    if (q[hi][d] < q[i][d]) { x = q[hi]; q[hi] = q[i]; q[i] = x; }
+    v = q[i][d];
+
+    for (i = lo, j = hi; i <= j; )
+    {
+      while (q[i][d] < v) i ++;
+      while (q[j][d] > v) j --;
+      if (i <= j) { x = q[i]; q[i] = q[j]; q[j] = x; i ++; j --; }
+    }
+
+    if (k <= j) hi = j;
+    else if (k >= i) lo = i;
+    else break;
   }
+}
 
-  extents [3] -= extents [0];
-  extents [4] -= extents [1];
-  extents [5] -= extents [2];
+/* empty extents */
+static void empty (double *e)
+{
+  e [0] = e [1] = e [2] = DBL_MAX;
+  e [3] = e [4] = e [5] = -DBL_MAX;
+}
 
-  if (extents [3] >= extents [4] && extents [3] >= extents [5]) *d = 0;
-  else if (extents [4] >= extents [3] && extents [4] >= extents [5]) *d = 1;
-  else *d = 2;
+/* grow extents 'e' by point 'x' */
+static void grow (double *e, double *x)
+{
+  if (x [0] < e [0]) e [0] = x [0];
+  if (x [1] < e [1]) e [1] = x [1];
+  if (x [2] < e [2]) e [2] = x [2];
+  if (x [0] > e [3]) e [3] = x [0];
+  if (x [1] > e [4]) e [4] = x [1];
+  if (x [2] > e [5]) e [5] = x [2];
+}
 
-  for (k = i = 0; k < 3; k ++)
-    if (k != *d) t [i ++] = k;
-  i = 0;
+/* extents 'e' of points q [0..n-1] */
+static void extents (double **q, int n, double *e)
+{
+  double **y;
+
+  empty (e);
+  for (y = q+n; q != y; q ++) grow (e, *q);
+}
+
+/* lexicographical order of points */
+static int greater (double *x, double *y)
+{
+  if (x [0] != y [0]) return x [0] > y [0];
+  if (x [1] != y [1]) return x [1] > y [1];
+  return x [2] > y [2];
+}
+
+/* split points with extents 'e' along most elongated direction; the splitting point q [k] is the
+ * last one of the coordinate run containing the lower median (or the last point of the preceding
+ * run, when the former run is the last one), so that q [0..k-1] are not greater and q [k+1..n-1]
+ * are greater than q [k] along 'd'; within its run q [k] is the lexicographically greatest point,
+ * so that the tree does not depend on the input order; expected linear time; extents of both
+ * halves are output */
+static int split (int n, double **q, double *e, double *p, int *d, double *le, double *re)
+{
+  double v, w, *x, eq [6];
+  int i, j, k, a, b, c, t [3];
 
-back:
-  qsort (q, n, sizeof (double*), qcmp [*d]);
-  /* find k such that q [l][d] > q [k][d] for l > k */
-  for (k = 0, j = -1; k < n; k ++)
+  t [0] = 0;
+  if (e [4] - e [1] > e [3+t[0]] - e [t[0]]) t [0] = 1;
+  if (e [5] - e [2] > e [3+t[0]] - e [t[0]]) t [0] = 2;
+  for (k = 0, i = 1; k < 3; k ++)
+    if (k != t [0]) t [i ++] = k;
+
+  for (i = 0; i < 3 && n > 1; i ++)
   {
-    if (k > 0 && q[k-1][*d] < q[k][*d])
+    *d = t [i];
+    if (e [*d+3] == e [*d]) continue; /* no good splitting along this dimension */
+
+    nth (q, n, n/2 - 1, *d);
+    v = q [n/2 - 1][*d];
+
+    /* three way partition q [0..a-1] < v, q [a..c-1] == v, q [c..n-1] > v,
+     * growing the extents of each part on the way */
+    empty (le);
+    empty (eq);
+    empty (re);
+    for (a = 0, b = c = n; a < b; )
+    {
+      w = q [a][*d];
+      if (w < v) { grow (le, q [a]); a ++; }
+      else if (w > v) { grow (re, q [a]); b --; c --; x = q [a]; q [a] = q [b]; q [b] = q [c]; q [c] = x; }
+      else { grow (eq, q [a]); b --; x = q [a]; q [a] = q [b]; q [b] = x; }
+    }
+
+    if (c < n) /* greater points follow => q [c-1] splits */
     {
-      if (k >= n/2)
+      for (j = a, k = a + 1; k < c; k ++)
+	if (greater (q[k], q[j])) j = k;
+      k = c - 1;
+      x = q [j]; q [j] = q [k]; q [k] = x;
+      if (c - a > 1) /* extents of the run without q [k] */
       {
-	k --;
-	break;
+	extents (q+a, k-a, eq);
+	for (j = 0; j < 3; j ++)
+	{
+	  if (eq [j] < le [j]) le [j] = eq [j];
+	  if (eq [j+3] > le [j+3]) le [j+3] = eq [j+3];
+	}
       }
-      else j = k-1;
     }
-  }
-
-  if (k == n && j >= 0) k = j; /* the last difference before n/2 */
-
-  while (k == n && i < 2) /* no good splitting along current dimension */
-  {
-    *d = t [i ++];
-    goto back;
-  }
+    else if (a > 0) /* v is the maximum => the greatest lesser point splits */
+    {
+      for (j = 0, k = 1; k < a; k ++)
+	if (q[k][*d] > q[j][*d] || (q[k][*d] == q[j][*d] && greater (q[k], q[j]))) j = k;
+      k = a - 1;
+      x = q [j]; q [j] = q [k]; q [k] = x;
+      extents (q, k, le);
+      COPY6 (eq, re);
+    }
+    else continue;
 
-  if (k == n)
-  {
-    COPY (q [0], p);
-    return -1; /* coincident points */
-  }
-  else
-  {
     COPY (q [k], p);
     return k;
   }
+
+  *d = t [2];
+  COPY (q [0], p);
+  return -1; /* coincident points */
 }
 
 /* recursive create */
-static KDT* create (KDT *u, int n, double **q)
+static KDT* create (KDT *u, int n, double **q, double *e)
 {
+  double le [6], re [6];
   KDT *kd;
   int k;
 
@@ -207,17 +259,28 @@ static KDT* create (KDT *u, int n, double **q)
     return kd;
   }
 
-  k = split (n, q, kd->p, &kd->d);
+  k = split (n, q, e, kd->p, &kd->d, le, re);
 
   if (k == -1) /* coincident points */
   {
-    kd->l = create (kd, 0, NULL);
-    kd->r = create (kd, 0, NULL);
+    kd->l = create (kd, 0, NULL, NULL);
+    kd->r = create (kd, 0, NULL, NULL);
   }
   else
   {
-    kd->l = create (kd, k, q); /* ends at q [k-1] */
-    kd->r = create (kd, n-k-1, q+k+1); /* starts at q [k+1] */
+#if OPENMP
+    #pragma omp task if (k > TASK_SIZE)
+#endif
+    kd->l = create (kd, k, q, le); /* ends at q [k-1] */
+
+#if OPENMP
+    #pragma omp task if (n-k-1 > TASK_SIZE)
+#endif
+    kd->r = create (kd, n-k-1, q+k+1, re); /* starts at q [k+1] */
+
+#if OPENMP
+    #pragma omp taskwait
+#endif
   }
 
   return kd;
@@ -239,14 +302,20 @@ static void index_nodes (KDT *kd, int *n)
  * between the input points and the remaining points are filtered our */
 KDT* KDT_Create (int n, double *p, double epsilon)
 {
-  double **q;
+  double **q, e [6];
   KDT *kd;
   int i;
 
   ERRMEM (q = malloc (n * sizeof (double*)));
   for (i = 0; i < n; i ++) q [i] = &p [3*i];
   n = separate (n, q, epsilon);
-  kd = create (NULL, n, q);
+  extents (q, n, e);
+
+#if OPENMP
+  #pragma omp parallel
+  #pragma omp single
+#endif
+  kd = create (NULL, n, q, e);
   free (q);
 
   return kd;
@@ -338,6 +407,238 @@ KDT* KDT_Nearest (KDT *kd, double *p, double epsilon)
   return c;
 }
 
+/* pending subtree of a proximity query and its squared distance lower bound */
+typedef struct { KDT *kd; double b; } PENDING;
+
+/* push a pending subtree; the stack moves from the local array to the heap when full */
+static void push (PENDING **stack, int *top, int *size, PENDING *local, KDT *kd, double b)
+{
+  if (*top == *size)
+  {
+    if (*stack == local)
+    {
+      ERRMEM (*stack = malloc (2 * (*size) * sizeof (PENDING)));
+      memcpy (*stack, local, (*size) * sizeof (PENDING));
+    }
+    else ERRMEM (*stack = realloc (*stack, 2 * (*size) * sizeof (PENDING)));
+    (*size) *= 2;
+  }
+
+  (*stack) [*top].kd = kd;
+  (*stack) [*top].b = b;
+  (*top) ++;
+}
+
+/* restore max-heap order of dist [0..m-1] (and nodes) below item 'i' */
+static void sift_down (KDT **nodes, double *dist, int m, int i)
+{
+  double x = dist [i];
+  KDT *y = nodes [i];
+  int j;
+
+  for (j = 2*i+1; j < m; i = j, j = 2*i+1)
+  {
+    if (j+1 < m && dist [j+1] > dist [j]) j ++;
+    if (dist [j] <= x) break;
+    dist [i] = dist [j];
+    nodes [i] = nodes [j];
+  }
+
+  dist [i] = x;
+  nodes [i] = y;
+}
+
+/* insert item into max-heap dist [0..m-1] (and nodes) */
+static void sift_up (KDT **nodes, double *dist, int m, KDT *y, double x)
+{
+  int i, j;
+
+  for (i = m; i > 0 && dist [j = (i-1)/2] < x; i = j)
+  {
+    dist [i] = dist [j];
+    nodes [i] = nodes [j];
+  }
+
+  dist [i] = x;
+  nodes [i] = y;
+}
+
+/* output up to k nearest nodes of kd-tree into 'nodes' and their squared
+ * distances from point into 'dist', in increasing distance order; return their number */
+int KDT_Knearest (KDT *kd, double *p, int k, KDT **nodes, double *dist)
+{
+  PENDING local [KDT_STACK], *stack, e;
+  double a [3], x, t;
+  int top, size, m;
+  KDT *far;
+
+  if (k <= 0 || kd->d < 0) return 0;
+
+  stack = local;
+  size = KDT_STACK;
+  top = m = 0;
+  push (&stack, &top, &size, local, kd, 0.0);
+
+  while (top > 0) /* nodes are kept in a bounded max-heap => dist [0] is the k-th distance so far */
+  {
+    e = stack [-- top];
+    if (m == k && e.b >= dist [0]) continue;
+
+    for (kd = e.kd; kd->d >= 0; )
+    {
+      SUB (p, kd->p, a);
+      x = DOT (a, a);
+
+      if (m < k) sift_up (nodes, dist, m ++, kd, x);
+      else if (x < dist [0])
+      {
+	dist [0] = x;
+	nodes [0] = kd;
+	sift_down (nodes, dist, m, 0);
+      }
+
+      t = p [kd->d] - kd->p [kd->d];
+      if (t <= 0.0) { far = kd->r; kd = kd->l; } /* descend the near side first */
+      else { far = kd->l; kd = kd->r; }
+
+      if (far->d >= 0 && (m < k || t*t < dist [0])) push (&stack, &top, &size, local, far, t*t);
+    }
+  }
+
+  if (stack != local) free (stack);
+
+  for (k = m-1; k > 0; k --) /* heap sort into increasing order */
+  {
+    x = dist [k]; dist [k] = dist [0]; dist [0] = x;
+    far = nodes [k]; nodes [k] = nodes [0]; nodes [0] = far;
+    sift_down (nodes, dist, k, 0);
+  }
+
+  return m;
+}
+
+/* append nodes within radius from point to the buffer of 'used' items; return the new number of items */
+static int within (KDT *kd, double *p, double radius, KDT ***nodes, int *size, int used)
+{
+  PENDING local [KDT_STACK], *stack, e;
+  double a [3], r, t;
+  int top, depth;
+  KDT *far;
+
+  if (kd->d < 0) return used;
+
+  stack = local;
+  depth = KDT_STACK;
+  top = 0;
+  r = radius * radius;
+  push (&stack, &top, &depth, local, kd, 0.0);
+
+  while (top > 0)
+  {
+    e = stack [-- top];
+
+    for (kd = e.kd; kd->d >= 0; )
+    {
+      SUB (p, kd->p, a);
+
+      if (DOT (a, a) <= r)
+      {
+	if (used == *size)
+	{
+	  *size = MAX (2 * (*size), 64);
+	  ERRMEM (*nodes = realloc (*nodes, (*size) * sizeof (KDT*)));
+	}
+	(*nodes) [used ++] = kd;
+      }
+
+      t = p [kd->d] - kd->p [kd->d];
+      if (t <= 0.0) { far = kd->r; kd = kd->l; }
+      else { far = kd->l; kd = kd->r; }
+
+      if (far->d >= 0 && t*t <= r) push (&stack, &top, &depth, local, far, t*t);
+    }
+  }
+
+  if (stack != local) free (stack);
+
+  return used;
+}
+
+/* output nodes of kd-tree within radius from point into the '*nodes' buffer of '*size' items,
+ * which is reallocated when too small (start with NULL and 0); return the number of output nodes */
+int KDT_Radius (KDT *kd, double *p, double radius, KDT ***nodes, int *size)
+{
+  return within (kd, p, radius, nodes, size, 0);
+}
+
+/* k nearest nodes of n points => row 'i' of the n by k 'nodes' and 'dist' arrays holds the
+ * result of KDT_Knearest for point p [3*i], padded with NULL nodes at DBL_MAX distance */
+void KDT_Knearest_Batch (KDT *kd, double *p, int n, int k, KDT **nodes, double *dist)
+{
+  size_t o;
+  int i, j;
+
+#if OPENMP
+  #pragma omp parallel for private (o, j) schedule (dynamic, 256)
+#endif
+  for (i = 0; i < n; i ++)
+  {
+    o = (size_t) i * k;
+    j = KDT_Knearest (kd, &p [3*i], k, &nodes [o], &dist [o]);
+    for (; j < k; j ++)
+    {
+      nodes [o+j] = NULL;
+      dist [o+j] = DBL_MAX;
+    }
+  }
+}
+
+/* nodes within radius from n points => return offsets 'off' of size n + 1 and output the
+ * '*nodes' array, so that (*nodes) [off [i]] ... (*nodes) [off [i+1]-1] are within radius
+ * from p [3*i] in the order of KDT_Radius; both arrays are to be freed by the caller */
+int* KDT_Radius_Batch (KDT *kd, double *p, int n, double radius, KDT ***nodes)
+{
+  KDT **out;
+  int *off;
+
+  ERRMEM (off = malloc ((n + 1) * sizeof (int)));
+  off [0] = 0;
+  out = NULL;
+
+#if OPENMP
+  #pragma omp parallel
+#endif
+  {
+    KDT **buf = NULL; /* per-thread results of a contiguous range of points */
+    int size = 0, used = 0, first = -1, i, m;
+
+#if OPENMP
+    #pragma omp for schedule (static)
+#endif
+    for (i = 0; i < n; i ++)
+    {
+      if (first < 0) first = i;
+      m = within (kd, &p [3*i], radius, &buf, &size, used);
+      off [i+1] = m - used;
+      used = m;
+    }
+
+#if OPENMP
+    #pragma omp single
+#endif
+    {
+      for (i = 0; i < n; i ++) off [i+1] += off [i];
+      ERRMEM (out = malloc (MAX (off [n], 1) * sizeof (KDT*)));
+    }
+
+    if (used) memcpy (out + off [first], buf, used * sizeof (KDT*));
+    free (buf);
+  }
+
+  *nodes = out;
+  return off;
+}
+
 /* return the number kd-tree nodes; note that kd->n indices
  * become valid for tree nodes only after KDT_Size was called */
 int KDT_Size (KDT *kd)
@@ -392,3 +693,215 @@ void KDT_Destroy (KDT *kd)
   free (kd->data);
   free (kd);
 }
+
+/* number of inner tree nodes */
+static int count (KDT *kd)
+{
+  return kd->d < 0 ? 0 : 1 + count (kd->l) + count (kd->r);
+}
+
+/* tree depth */
+static int depth (KDT *kd)
+{
+  int l, r;
+
+  if (kd->d < 0) return 0;
+
+  l = depth (kd->l);
+  r = depth (kd->r);
+
+  return 1 + (l > r ? l : r);
+}
+
+/* list inner nodes within 'h' levels of 'kd' in van Emde Boas order */
+static void veb (KDT *kd, int h, KDT **order, int *n);
+
+/* list subtrees of height 'h' rooted 't' levels below 'kd' in van Emde Boas order */
+static void bottom (KDT *kd, int t, int h, KDT **order, int *n)
+{
+  if (kd->d < 0) return;
+  else if (t == 0) veb (kd, h, order, n);
+  else
+  {
+    bottom (kd->l, t-1, h, order, n);
+    bottom (kd->r, t-1, h, order, n);
+  }
+}
+
+/* list inner nodes within 'h' levels of 'kd' in van Emde Boas order => the top half
+ * of the levels is listed first and it is followed by the subtrees hanging below it */
+static void veb (KDT *kd, int h, KDT **order, int *n)
+{
+  int t;
+
+  if (kd->d < 0 || h == 0) return;
+  else if (h == 1) order [(*n) ++] = kd;
+  else
+  {
+    t = (h + 1) / 2;
+    veb (kd, t, order, n);
+    bottom (kd, t, h - t, order, n);
+  }
+}
+
+/* convert kd-tree into a flat kd-tree */
+KDTFLAT* KDT_Flatten (KDT *kd)
+{
+  int nnode, nleaf, ndata, i, j, k, *save;
+  KDTFLAT *kf;
+  KDT **order, *x, *y;
+  KDTNODE *z;
+
+  nnode = count (kd);
+  nleaf = nnode + 1; /* inner nodes have two children */
+
+  ERRMEM (order = malloc ((sizeof (KDT*) + sizeof (int)) * (nnode + 1)));
+  save = (int*) (order + nnode + 1);
+
+  i = 0;
+  veb (kd, depth (kd), order, &i);
+  ASSERT_DEBUG (i == nnode, "Inconsistent van Emde Boas order");
+
+  for (i = 0, ndata = 0; i < nnode; i ++)
+  {
+    x = order [i];
+    save [i] = x->n;
+    x->n = i; /* inner node indices are restored below */
+    if (x->l->d < 0) ndata += x->l->n;
+    if (x->r->d < 0) ndata += x->r->n;
+  }
+  if (kd->d < 0) ndata += kd->n;
+
+  ERRMEM (kf = malloc (sizeof (KDTFLAT) + sizeof (KDTNODE) * nnode + sizeof (void*) * ndata + sizeof (int) * (nleaf + 1)));
+  kf->node = (KDTNODE*) (kf + 1);
+  kf->data = (void**) (kf->node + nnode);
+  kf->off = (int*) (kf->data + ndata);
+  kf->nnode = nnode;
+  kf->nleaf = nleaf;
+  kf->depth = depth (kd);
+  kf->off [0] = 0;
+
+  if (kd->d < 0) /* single leaf */
+  {
+    if (kd->n) memcpy (kf->data, kd->data, sizeof (void*) * kd->n);
+    kf->off [1] = kd->n;
+  }
+
+  for (i = k = 0; i < nnode; i ++) /* leaves are numbered as their parents are visited */
+  {
+    x = order [i];
+    z = &kf->node [i];
+    COPY (x->p, z->p);
+    z->d = x->d;
+
+    for (j = 0; j < 2; j ++)
+    {
+      y = j ? x->r : x->l;
+
+      if (y->d >= 0) z->c [j] = y->n;
+      else
+      {
+	z->c [j] = KDT_LEAF (k);
+	if (y->n) memcpy (kf->data + kf->off [k], y->data, sizeof (void*) * y->n);
+	kf->off [k+1] = kf->off [k] + y->n;
+	k ++;
+      }
+    }
+  }
+
+  for (i = 0; i < nnode; i ++) order [i]->n = save [i];
+
+  free (order);
+
+  return kf;
+}
+
+/* pick leaf containing point in flat kd-tree */
+int KDT_Pick_Flat (KDTFLAT *kf, double *p)
+{
+  KDTNODE *node = kf->node, *x;
+  int c;
+
+  for (c = kf->nnode ? 0 : -1; c >= 0; )
+  {
+    x = &node [c];
+    c = x->c [p [x->d] > x->p [x->d]];
+  }
+
+  return KDT_LEAF (c);
+}
+
+/* pick leaves of flat kd-tree overlapping the extents */
+int KDT_Pick_Extents_Flat (KDTFLAT *kf, double *extents, int *leaves)
+{
+  int local [KDT_STACK], *stack, top, c, m;
+  KDTNODE *x;
+
+  if (kf->depth < KDT_STACK) stack = local; /* at most one pending node per level */
+  else ERRMEM (stack = malloc (sizeof (int) * (kf->depth + 1)));
+
+  for (stack [0] = kf->nnode ? 0 : -1, top = 1, m = 0; top; )
+  {
+    for (c = stack [-- top]; c >= 0; )
+    {
+      x = &kf->node [c];
+
+      if (extents [x->d+3] <= x->p [x->d]) c = x->c [0];
+      else if (extents [x->d] > x->p [x->d]) c = x->c [1];
+      else
+      {
+	stack [top ++] = x->c [1]; /* right visited after left, as in KDT_Pick_Extents */
+	c = x->c [0];
+      }
+    }
+
+    leaves [m ++] = KDT_LEAF (c);
+  }
+
+  if (stack != local) free (stack);
+
+  return m;
+}
+
+/* return nearest node in flat kd-tree within epsilon radius */
+int KDT_Nearest_Flat (KDTFLAT *kf, double *p, double epsilon)
+{
+  int local [KDT_STACK], *stack, top, c, min;
+  double a [3], d, dmax;
+  KDTNODE *x;
+
+  if (kf->depth < KDT_STACK) stack = local;
+  else ERRMEM (stack = malloc (sizeof (int) * (kf->depth + 1)));
+
+  dmax = DBL_MAX;
+  min = -1;
+
+  for (stack [0] = kf->nnode ? 0 : -1, top = 1; top; )
+  {
+    for (c = stack [-- top]; c >= 0; )
+    {
+      x = &kf->node [c];
+      SUB (p, x->p, a);
+      d = DOT (a, a);
+      if (d < dmax) { dmax = d; min = c; }
+
+      if ((p [x->d] + epsilon) <= x->p [x->d]) c = x->c [0];
+      else if ((p [x->d] - epsilon) > x->p [x->d]) c = x->c [1];
+      else
+      {
+	stack [top ++] = x->c [1]; /* right visited after left, as in KDT_Nearest */
+	c = x->c [0];
+      }
+    }
+  }
+
+  if (stack != local) free (stack);
+
+  return min;
+}
+
+/* destroy flat kd-tree */
+void KDT_Destroy_Flat (KDTFLAT *kf)
+{
+  free (kf);
+}
@@ -46,6 +46,32 @@ struct kdt
   void **data; /* leaf data items */
 };
 
+typedef struct kdt_node KDTNODE; /* flat kd-tree inner node */
+
+struct kdt_node
+{
+  double p [3]; /* point */
+
+  int d; /* splitting dimension */
+
+  int c [2]; /* left and right child => inner node index if >= 0, otherwise KDT_LEAF (c) is the leaf index */
+};
+
+#define KDT_LEAF(c) (-1-(c)) /* leaf index of a negative child and vice versa */
+
+typedef struct kdt_flat KDTFLAT; /* flat kd-tree */
+
+struct kdt_flat
+{
+  KDTNODE *node; /* inner nodes in van Emde Boas order; node [0] is the root unless nnode == 0 */
+
+  int *off; /* leaf data offsets of size nleaf + 1 => leaf 'i' data items are data [off [i]] ... data [off [i+1]-1] */
+
+  void **data; /* leaf data items */
+
+  int nnode, nleaf, depth;
+};
+
 /* create kd-tree for n points; epsilon separation is ensured
  * between the input points and the remaining points are filtered our */
 KDT* KDT_Create (int n, double *p, double epsilon);
@@ -62,6 +88,23 @@ void KDT_Pick_Extents (KDT *kd, double *extents, SET **leaves);
 /* return nearest node in kd-tree within epsilon radius */
 KDT* KDT_Nearest (KDT *kd, double *p, double epsilon);
 
+/* output up to k nearest nodes of kd-tree into 'nodes' and their squared
+ * distances from point into 'dist', in increasing distance order; return their number */
+int KDT_Knearest (KDT *kd, double *p, int k, KDT **nodes, double *dist);
+
+/* output nodes of kd-tree within radius from point into the '*nodes' buffer of '*size' items,
+ * which is reallocated when too small (start with NULL and 0); return the number of output nodes */
+int KDT_Radius (KDT *kd, double *p, double radius, KDT ***nodes, int *size);
+
+/* k nearest nodes of n points => row 'i' of the n by k 'nodes' and 'dist' arrays holds the
+ * result of KDT_Knearest for point p [3*i], padded with NULL nodes at DBL_MAX distance */
+void KDT_Knearest_Batch (KDT *kd, double *p, int n, int k, KDT **nodes, double *dist);
+
+/* nodes within radius from n points => return offsets 'off' of size n + 1 and output the
+ * '*nodes' array, so that (*nodes) [off [i]] ... (*nodes) [off [i+1]-1] are within radius
+ * from p [3*i] in the order of KDT_Radius; both arrays are to be freed by the caller */
+int* KDT_Radius_Batch (KDT *kd, double *p, int n, double radius, KDT ***nodes);
+
 /* return the number kd-tree nodes; note that kd->n indices
  * become valid for tree nodes only after KDT_Size was called */
 int KDT_Size (KDT *kd);
@@ -75,4 +118,21 @@ KDT* KDT_Next (KDT *kd);
 /* destroy kd-tree */
 void KDT_Destroy (KDT *kd);
 
+/* convert kd-tree, including its leaf data items, into a flat kd-tree
+ * stored in one continuous memory block; the input tree is not modified */
+KDTFLAT* KDT_Flatten (KDT *kd);
+
+/* return index of the leaf containing point in flat kd-tree */
+int KDT_Pick_Flat (KDTFLAT *kf, double *p);
+
+/* output indices of the leaves of flat kd-tree overlapping the extents into
+ * 'leaves' (of size up to nleaf), in the order of KDT_Pick_Extents; return their number */
+int KDT_Pick_Extents_Flat (KDTFLAT *kf, double *extents, int *leaves);
+
+/* return index of the nearest node in flat kd-tree within epsilon radius or -1 */
+int KDT_Nearest_Flat (KDTFLAT *kf, double *p, double epsilon);
+
+/* destroy flat kd-tree */
+void KDT_Destroy_Flat (KDTFLAT *kf);
+
 #endif
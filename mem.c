@@ -37,6 +37,8 @@
 
 typedef struct { void *p; size_t margin; } PTR; /* pointer with margin */
 
+#define ARENA_ALIGN(size) (((size) + sizeof(PTR) - 1) & ~(sizeof(PTR) - 1)) /* arena chunk alignment */
+
 void* MEM_CALLOC (size_t size)
 {
   void *chunk;
@@ -60,6 +62,13 @@ void MEM_Init (MEM *pool, size_t chunksize, size_t chunksinblock)
   pool->freechunk = NULL;
   pool->lastchunk = NULL;
   pool->deadchunks = NULL;
+  pool->arena = NULL;
+}
+
+void MEM_Init_Arena (MEM *pool, size_t chunksize, size_t chunksinblock, ARENA *arena)
+{
+  MEM_Init (pool, chunksize, chunksinblock);
+  pool->arena = arena;
 }
 
 void* MEM_Alloc (MEM *pool)
@@ -88,7 +97,7 @@ void* MEM_Alloc (MEM *pool)
   { /* else if we need to allocate a new block ... */
    
     /* allocate a block of memory */
-    block = malloc (pool->chunksize * pool->chunksinblock + sizeof(PTR));
+    block = ARENA_Alloc (pool->arena, pool->chunksize * pool->chunksinblock + sizeof(PTR));
     if (!block) return NULL; /* do not exit() here */
     memset (block, 0, pool->chunksize * pool->chunksinblock + sizeof(PTR));
    
@@ -156,7 +165,7 @@ void MEM_Release (MEM *pool)
   size_t next;
   
   /* traverse and free all blocks of memory */
-  while (block)
+  while (block && !pool->arena)
   {
     next = *((size_t*)block);
     free (block);
@@ -169,3 +178,84 @@ void MEM_Release (MEM *pool)
   pool->lastchunk = NULL;
   pool->deadchunks = NULL;
 }
+
+void ARENA_Init (ARENA *arena, size_t size)
+{
+  arena->blocks = NULL;
+  arena->top = NULL;
+  arena->end = NULL;
+  arena->size = 0;
+
+  if (size)
+  {
+    ERRMEM (arena->blocks = malloc (size + sizeof(PTR)));
+    ((PTR*)arena->blocks)->p = NULL;
+    ((PTR*)arena->blocks)->margin = size;
+    arena->top = (char*)arena->blocks + sizeof(PTR);
+    arena->end = arena->top + size;
+    arena->size = size;
+  }
+}
+
+void* ARENA_Alloc (ARENA *arena, size_t size)
+{
+  void *chunk, *block;
+  size_t blocksize;
+
+  if (!arena) return malloc (size);
+
+  size = ARENA_ALIGN (size);
+
+  if (!arena->top || arena->top + size > arena->end)
+  { /* the current block is too small => allocate a new one */
+
+    blocksize = (arena->size > size ? arena->size : size);
+    if (blocksize < 4096) blocksize = 4096;
+    block = malloc (blocksize + sizeof(PTR));
+    if (!block) return NULL; /* do not exit() here */
+
+    /* insert allocated block into the list */
+    ((PTR*)block)->p = arena->blocks;
+    ((PTR*)block)->margin = blocksize;
+    arena->blocks = block;
+    arena->top = (char*)block + sizeof(PTR);
+    arena->end = arena->top + blocksize;
+    arena->size += blocksize;
+  }
+
+  chunk = arena->top;
+  arena->top += size;
+  return chunk;
+}
+
+void ARENA_Reset (ARENA *arena)
+{
+  size_t size = arena->size;
+
+  if (arena->blocks && ((PTR*)arena->blocks)->p)
+  { /* more than one block => coalesce */
+    ARENA_Release (arena);
+    ARENA_Init (arena, size);
+  }
+  else if (arena->blocks)
+  {
+    arena->top = (char*)arena->blocks + sizeof(PTR);
+  }
+}
+
+void ARENA_Release (ARENA *arena)
+{
+  void *block = arena->blocks, *next;
+
+  while (block)
+  {
+    next = ((PTR*)block)->p;
+    free (block);
+    block = next;
+  }
+
+  arena->blocks = NULL;
+  arena->top = NULL;
+  arena->end = NULL;
+  arena->size = 0;
+}
@@ -31,6 +31,16 @@
 #ifndef __mem__
 #define __mem__
 
+typedef struct memory_arena ARENA;
+
+struct memory_arena
+{
+  void *blocks; /* list of allocated memory blocks (current first) */
+  char *top; /* next free byte in the current block */
+  char *end; /* end of the current block */
+  size_t size; /* total size of all blocks */
+};
+
 typedef struct memory_pool MEM;
 
 struct memory_pool 
@@ -41,6 +51,7 @@ struct memory_pool
   void *deadchunks; /* list of dealocated chunks of memory */
   size_t chunksize; /* size of a chunk */
   size_t chunksinblock; /* number of memory chunks in a block */
+  ARENA *arena; /* source of blocks or NULL (heap) */
 };
 
 /* allocate global zero'd memory */
@@ -49,6 +60,11 @@ void* MEM_CALLOC (size_t size);
 /* initialize memory pool */
 void MEM_Init (MEM *pool, size_t chunksize, size_t chunksinblock);
 
+/* initialize memory pool whose blocks are allocated from an arena; MEM_Release
+ * does not free them, they are reclaimed together with the arena memory;
+ * for a NULL 'arena' this is equivalent to MEM_Init */
+void MEM_Init_Arena (MEM *pool, size_t chunksize, size_t chunksinblock, ARENA *arena);
+
 /* allocate a chunk of memory from the pool */
 void* MEM_Alloc (MEM *pool);
 
@@ -61,4 +77,20 @@ size_t MEM_Size (MEM *pool);
 /* release memory pool memory back to system */
 void MEM_Release (MEM *pool);
 
+/* initialize memory arena with an initial block size (or zero) */
+void ARENA_Init (ARENA *arena, size_t size);
+
+/* allocate 'size' bytes from the arena; arena memory is released
+ * only as a whole, by ARENA_Reset or ARENA_Release; for a NULL
+ * 'arena' the memory is malloc'ed and needs to be freed */
+void* ARENA_Alloc (ARENA *arena, size_t size);
+
+/* make all arena memory available again; if the arena has grown into
+ * several blocks they are coalesced into one, so that a repeated use
+ * of the same amount of memory causes no further heap allocation */
+void ARENA_Reset (ARENA *arena);
+
+/* release arena memory back to system */
+void ARENA_Release (ARENA *arena);
+
 #endif
@@ -0,0 +1,372 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Tomasz Koziara
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * bvhtest.c: bounding volume hierarchy tests
+ */
+
+#include <float.h>
+#include "tst.h"
+#include "bvh.h"
+
+/* hull of 'n' points on the sphere (c, r) */
+static TRI* sphere (double *c, double r, int n, double **v, int *m)
+{
+  double d [3];
+  int i;
+
+  *v = malloc (sizeof (double [3]) * n);
+
+  for (i = 0; i < n; i ++)
+  {
+    tst_direction (d);
+    ADDMUL (c, r, d, &(*v) [3*i]);
+  }
+
+  return hull (*v, n, m);
+}
+
+/* squared distance from 'p' to the segment (a, b) */
+static double segdist (double *p, double *a, double *b)
+{
+  double ab [3], ap [3], q [3], s;
+
+  SUB (b, a, ab);
+  SUB (p, a, ap);
+  s = DOT (ap, ab) / DOT (ab, ab);
+  s = s < 0.0 ? 0.0 : s > 1.0 ? 1.0 : s;
+  ADDMUL (a, s, ab, q);
+  SUB (p, q, q);
+
+  return DOT (q, q);
+}
+
+/* squared distance from 'p' to the triangle 't': to its plane if the
+ * projection falls inside of it, or else to the nearest edge */
+static double tridist (TRI *t, double *p)
+{
+  double n [3], e [3], q [3], r [3], d, x;
+  int i;
+
+  NORMAL (t->ver [0], t->ver [1], t->ver [2], n);
+
+  for (i = 0; i < 3; i ++)
+  {
+    SUB (t->ver [(i+1)%3], t->ver [i], e);
+    SUB (p, t->ver [i], q);
+    PRODUCT (e, q, r);
+    if (DOT (r, n) < 0.0) break; /* outside of edge 'i' */
+  }
+
+  if (i == 3)
+  {
+    d = DOT (n, q);
+    return d * d / DOT (n, n);
+  }
+
+  d = segdist (p, t->ver [0], t->ver [1]);
+  x = segdist (p, t->ver [1], t->ver [2]);
+  d = MIN (d, x);
+  x = segdist (p, t->ver [2], t->ver [0]);
+
+  return MIN (d, x);
+}
+
+/* do the extents of the triangle 't' overlap the extents 'e' */
+static int overlaps (TRI *t, double *e)
+{
+  int k;
+
+  for (k = 0; k < 3; k ++)
+  {
+    if (MIN (MIN (t->ver [0][k], t->ver [1][k]), t->ver [2][k]) > e [k+3] ||
+        MAX (MAX (t->ver [0][k], t->ver [1][k]), t->ver [2][k]) < e [k]) return 0;
+  }
+
+  return 1;
+}
+
+/* mark a reported triangle */
+static void mark (void *data, TRI *t)
+{
+  t->flg ++;
+}
+
+/* extents, sphere, ray and closest point queries agree with the brute force
+ * ones on a convex surface, whose ray entry distance follows from its planes */
+static void queries (void)
+{
+  double c [3] = {0.0, 0.0, 0.0}, e [6], p [3], q [3], d [3], x [3], *v, *pts, *cls, *dst, r, t, tin, tout, a, b, best;
+  int i, j, k, m, n = 200, cnt, ok;
+  TRI *tri, **tab;
+  BVH *bvh;
+
+  srand (17);
+
+  tri = sphere (c, 1.0, 3000, &v, &m);
+  bvh = BVH_Create (tri, m);
+  CHECK (bvh && bvh->ntri == m);
+
+  for (i = 0; i < n; i ++)
+  {
+    tst_direction (p);
+    SCALE (p, DRANDEXT (0.0, 1.5));
+    r = DRANDEXT (0.0, 0.5);
+
+    for (j = 0; j < 3; j ++) { e [j] = p [j] - r; e [j+3] = p [j] + r; }
+    for (j = 0; j < m; j ++) tri [j].flg = 0;
+    cnt = BVH_Extents (bvh, e, NULL, mark);
+    for (j = k = 0, ok = 1; j < m; j ++)
+    {
+      ok = ok && tri [j].flg == overlaps (&tri [j], e);
+      k += tri [j].flg;
+    }
+    CHECK (ok && cnt == k);
+
+    for (j = 0; j < m; j ++) tri [j].flg = 0;
+    cnt = BVH_Sphere (bvh, p, r, NULL, mark);
+    for (j = k = 0, ok = 1; j < m; j ++)
+    {
+      ok = ok && tri [j].flg == (tridist (&tri [j], p) <= r*r);
+      k += tri [j].flg;
+    }
+    CHECK (ok && cnt == k);
+
+    best = DBL_MAX;
+    CHECK (BVH_Closest (bvh, p, q, &best) != NULL);
+    for (j = 0, a = DBL_MAX; j < m; j ++) { b = tridist (&tri [j], p); a = MIN (a, b); }
+    CHECK_CLOSE (best, a, 1E-10);
+    SUB (q, p, x);
+    CHECK_CLOSE (DOT (x, x), best, 1E-10);
+
+    tst_direction (d); /* ray from outside towards the inside */
+    ADDMUL (p, -3.0, d, x);
+    for (j = 0, tin = 0.0, tout = DBL_MAX; j < m; j ++)
+    {
+      SUB (tri [j].ver [0], x, q);
+      a = DOT (tri [j].out, q);
+      b = DOT (tri [j].out, d);
+      if (b < 0.0) tin = MAX (tin, a / b);
+      else if (b > 0.0) tout = MIN (tout, a / b);
+    }
+    t = 10.0;
+    if (tin <= tout)
+    {
+      CHECK (BVH_Ray (bvh, x, d, &t) != NULL);
+      CHECK_CLOSE (t, tin, 1E-10);
+    }
+    else CHECK (BVH_Ray (bvh, x, d, &t) == NULL && t == 10.0);
+  }
+
+  pts = malloc (sizeof (double [7]) * n); /* batch equals single queries */
+  cls = pts + 3*n;
+  dst = cls + 3*n;
+  tab = malloc (sizeof (TRI*) * n);
+  for (i = 0; i < n; i ++) { tst_direction (&pts [3*i]); SCALE (&pts [3*i], DRANDEXT (0.0, 2.0)); }
+  BVH_Closest_Batch (bvh, pts, n, cls, dst, tab);
+  for (i = 0, ok = 1; i < n; i ++)
+  {
+    best = DBL_MAX;
+    ok = ok && BVH_Closest (bvh, &pts [3*i], q, &best) == tab [i] && best == dst [i] &&
+	 q [0] == cls [3*i] && q [1] == cls [3*i+1] && q [2] == cls [3*i+2];
+  }
+  CHECK (ok);
+
+  free (tab);
+  free (pts);
+  BVH_Destroy (bvh);
+  free (tri);
+  free (v);
+}
+
+/* signed distance of a rotated box with points scattered on its faces (hence triangles of very
+ * different areas meet along its edges and at its corners) equals the closed form, also near
+ * the edges and corners, where the sign follows the edge and vertex pseudo-normals */
+static void distance (void)
+{
+  double c [3] = {0.2, -0.1, 0.3}, h [3] = {1.0, 0.5, 2.0}, o [3] = {0.5, 0.3, -0.4};
+  double R [9], x [3], y [3], q [3], *v, *pts, *dst, d, out, in;
+  int i, j, k, m, n = 2000, l = 500;
+  BVHSURF *surf;
+  TRI *tri, *t;
+
+  srand (18);
+
+  EXPMAP (o, R);
+  v = malloc (sizeof (double [3]) * n);
+
+  for (i = 0; i < n; i ++)
+  {
+    for (j = 0; j < 3; j ++) x [j] = DRANDEXT (-h [j], h [j]);
+    if (i < 8) for (j = 0; j < 3; j ++) x [j] = i & (1 << j) ? h [j] : -h [j]; /* corners */
+    else { j = i % 3; x [j] = i & 1 ? h [j] : -h [j]; } /* on a face */
+    NVADDMUL (c, R, x, &v [3*i]);
+  }
+
+  tri = hull (v, n, &m);
+  surf = BVH_Surface (tri, m);
+  pts = malloc (sizeof (double [4]) * l);
+  dst = pts + 3*l;
+
+  for (i = 0; i < l; i ++)
+  {
+    for (j = 0; j < 3; j ++) x [j] = DRANDEXT (-1.5, 1.5) * h [j];
+    if (i % 2) for (j = 0; j < 2; j ++) /* near an edge or a corner */
+    {
+      k = (i / 2 + j) % 3;
+      x [k] = (x [k] > 0.0 ? h [k] : -h [k]) + DRANDEXT (-1E-3, 1E-3);
+    }
+    NVADDMUL (c, R, x, &pts [3*i]);
+
+    for (j = 0, out = 0.0, in = -DBL_MAX; j < 3; j ++) /* box distance */
+    {
+      d = fabs (x [j]) - h [j];
+      if (d > 0.0) out += d*d;
+      in = MAX (in, d);
+    }
+    d = out > 0.0 ? sqrt (out) : in;
+
+    CHECK_CLOSE (BVH_Distance (surf, &pts [3*i], y, &t), d, 1E-10);
+    SUB (y, &pts [3*i], q);
+    CHECK_CLOSE (LEN (q), fabs (d), 1E-10);
+    CHECK (t != NULL);
+  }
+
+  BVH_Distance_Batch (surf, pts, l, dst, NULL);
+  for (i = 0; i < l; i ++) CHECK (dst [i] == BVH_Distance (surf, &pts [3*i], NULL, NULL));
+
+  free (pts);
+  BVH_Surface_Destroy (surf);
+  free (tri);
+  free (v);
+}
+
+/* signs of distances to random flat hulls, whose faces meet at sharp edges and vertices
+ * and vary in area, for points near their vertices, against the hull plane inclusion */
+static void distance_sign (void)
+{
+  double c [3] = {0.0, 0.0, 0.0}, p [3], q [3], *v, d, s;
+  int i, j, k, l, m, ok;
+  BVHSURF *surf;
+  TRI *tri;
+
+  srand (19);
+
+  for (k = 0, ok = 1; k < 20; k ++)
+  {
+    tri = sphere (c, 1.0, 50 + k, &v, &m);
+    for (i = 0; i < 50 + k; i ++) v [3*i+2] *= 0.1; /* flatten the hull */
+    for (i = 0; i < m; i ++) NORMAL (tri [i].ver [0], tri [i].ver [1], tri [i].ver [2], tri [i].out);
+    surf = BVH_Surface (tri, m);
+
+    for (l = 0; l < 1000; l ++)
+    {
+      tst_direction (p);
+      ADDMUL (tri [l % m].ver [l % 3], 1E-3, p, p);
+
+      for (j = 0, s = -DBL_MAX; j < m; j ++)
+      {
+	SUB (p, tri [j].ver [0], q);
+	d = DOT (tri [j].out, q) / LEN (tri [j].out);
+	s = MAX (s, d);
+      }
+
+      d = BVH_Distance (surf, p, NULL, NULL);
+      if (fabs (s) > 1E-10) ok = ok && (d > 0.0) == (s > 0.0);
+    }
+
+    BVH_Surface_Destroy (surf);
+    free (tri);
+    free (v);
+  }
+
+  CHECK (ok);
+}
+
+/* topological queries on two disjoint hulls in one table report the component of the nearest
+ * in order triangle, as TRI_Topoadj does, but leave the input order and flags intact */
+static void topoadj (void)
+{
+  double c [3] = {0.0, 0.0, 0.0}, d [3] = {3.0, 0.0, 0.0}, p [3], *v, *w;
+  int i, j, k, l, m, na, nb, *in, ok;
+  TRI *a, *b, *tri, *copy, *t, **list;
+  BVHTOPO *topo;
+
+  srand (23);
+
+  a = sphere (c, 1.0, 100, &v, &na);
+  b = sphere (d, 1.0, 150, &w, &nb);
+  tri = TRI_Merge (a, na, b, nb, &m);
+  CHECK (m == na + nb);
+  TRI_Compadj (tri, m);
+  for (i = 0; i < m; i ++) tri [i].flg = i;
+  topo = BVH_Topology (tri, m);
+  in = malloc (sizeof (int) * m);
+
+  for (l = 0; l < 100; l ++)
+  {
+    j = rand () % m;
+    if (l % 10) { ADDMUL (tri [j].ver [l % 3], GEOMETRIC_EPSILON, tri [j].out, p); }
+    else { COPY (j < na ? c : d, p); } /* hull center is far from the surface */
+
+    list = BVH_Topoadj (topo, p, &k);
+    for (i = 0, ok = 1; i < m; i ++) { ok = ok && tri [i].flg == i; in [i] = 0; }
+    CHECK (ok);
+
+    copy = TRI_Copy (tri, m);
+    TRI_Compadj (copy, m);
+    for (i = 0; i < m; i ++) copy [i].ptr = &tri [i];
+    t = TRI_Topoadj (copy, m, p, &i);
+    CHECK (i == k);
+
+    if (l % 10 == 0) { CHECK (list == NULL && t == NULL && k == 0); }
+    else
+    {
+      CHECK (k == (j < na ? na : nb));
+      for (i = 0, ok = 1; i < k; i ++) ok = ok && (in [list [i] - tri] ++) == 0 && (list [i] - tri < na) == (j < na);
+      for (i = 0; i < k; i ++) ok = ok && in [(TRI*) copy [i].ptr - tri] == 1;
+      CHECK (ok);
+    }
+
+    free (copy);
+  }
+
+  free (in);
+  BVH_Topology_Destroy (topo);
+  free (tri);
+  free (a);
+  free (b);
+  free (v);
+  free (w);
+}
+
+int main (int argc, char **argv)
+{
+  RUN (queries);
+  RUN (distance);
+  RUN (distance_sign);
+  RUN (topoadj);
+
+  return DONE ();
+}
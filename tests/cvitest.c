@@ -0,0 +1,604 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Tomasz Koziara
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * cvitest.c: convex intersection tests
+ */
+
+#include <float.h>
+#include "tst.h"
+#include "cvi.h"
+
+#define NPAIRS 64
+
+static double *va [NPAIRS], *pa [NPAIRS], *vb [NPAIRS], *pb [NPAIRS];
+static int nva [NPAIRS], npa [NPAIRS], nvb [NPAIRS], npb [NPAIRS];
+
+/* random pairs of unit polytopes, overlapping or not */
+static void pairs (void)
+{
+  double a [3] = {0.0, 0.0, 0.0}, b [3];
+  int i;
+
+  srand (1);
+
+  for (i = 0; i < NPAIRS; i ++)
+  {
+    tst_direction (b);
+    SCALE (b, DRANDEXT (0.5, 2.5));
+    tst_polytope (a, 1.0, 50, &va [i], &nva [i], &pa [i], &npa [i]);
+    tst_polytope (b, 1.0, 50, &vb [i], &nvb [i], &pb [i], &npb [i]);
+  }
+}
+
+/* batched intersection with 1 and N workers agrees with sequential cvi */
+static void batch (void)
+{
+  double vol [NPAIRS], *pv;
+  int i, j, m [NPAIRS], nv, nw [2] = {1, 4};
+  CVIPAIR pair [NPAIRS];
+  CVIBATCH *bt;
+  CVIOUT *out;
+  TRI *tri;
+
+  for (i = 0; i < NPAIRS; i ++)
+  {
+    tri = cvi (va [i], nva [i], pa [i], npa [i], vb [i], nvb [i], pb [i], npb [i], REGULARIZED, &m [i], &pv, &nv);
+    vol [i] = tst_volume (tri, m [i]);
+    free (tri);
+
+    pair [i].va = va [i]; pair [i].nva = nva [i];
+    pair [i].pa = pa [i]; pair [i].npa = npa [i];
+    pair [i].vb = vb [i]; pair [i].nvb = nvb [i];
+    pair [i].pb = pb [i]; pair [i].npb = npb [i];
+    pair [i].data = NULL;
+  }
+
+  for (j = 0; j < 2; j ++)
+  {
+    bt = cvi_batch_create (nw [j]);
+    out = cvi_batch (bt, pair, NPAIRS, REGULARIZED);
+
+    for (i = 0; i < NPAIRS; i ++)
+    {
+      CHECK (out [i].m == m [i]);
+      CHECK_CLOSE (tst_volume (out [i].tri, out [i].m), vol [i], 1E-12);
+    }
+
+    cvi_batch_destroy (bt);
+  }
+
+  for (i = 0, j = 0; i < NPAIRS; i ++) j += m [i] > 0;
+  CHECK (j > 0 && j < NPAIRS); /* both empty and nonempty intersections */
+}
+
+/* box with half sizes 'h', rotated by 'omega' about its centre 'c' */
+static void box (double *c, double *h, double *omega, double *v, double *p)
+{
+  double R [9], x [3];
+  int i;
+
+  EXPMAP (omega, R);
+
+  for (i = 0; i < 8; i ++)
+  {
+    x [0] = i & 1 ? h [0] : -h [0];
+    x [1] = i & 2 ? h [1] : -h [1];
+    x [2] = i & 4 ? h [2] : -h [2];
+    NVADDMUL (c, R, x, v + 3*i);
+  }
+
+  for (i = 0; i < 6; i ++)
+  {
+    SET (x, 0.0);
+    x [i/2] = i & 1 ? -1.0 : 1.0;
+    NVMUL (R, x, p + 6*i);
+    x [i/2] *= h [i/2];
+    NVADDMUL (c, R, x, p + 6*i + 3);
+  }
+}
+
+/* do two triangle tables hold the same vertex coordinates and flags */
+static int same (TRI *a, TRI *b, int m)
+{
+  int i, j;
+
+  for (i = 0; i < m; i ++)
+  {
+    if (a [i].flg != b [i].flg) return 0;
+    for (j = 0; j < 3; j ++) if (memcmp (a [i].ver [j], b [i].ver [j], sizeof (double [3]))) return 0;
+  }
+
+  return 1;
+}
+
+/* arena based intersection equals the heap based one, its output lies in the arena,
+ * and after a first round a reset arena serves the same pairs without growing */
+static void arena_reuse (void)
+{
+  double *pv, *pw;
+  int i, j, m, l, nv, nw;
+  TRI *tri, *ref;
+  ARENA arena;
+  size_t size = 0;
+
+  ARENA_Init (&arena, 0);
+
+  for (j = 0; j < 2; j ++)
+  {
+    for (i = 0; i < NPAIRS; i ++)
+    {
+      ARENA_Reset (&arena);
+      tri = cvi_arena (va [i], nva [i], pa [i], npa [i], vb [i], nvb [i], pb [i], npb [i], NON_REGULARIZED, &m, &pv, &nv, NULL, &arena);
+      ref = cvi (va [i], nva [i], pa [i], npa [i], vb [i], nvb [i], pb [i], npb [i], NON_REGULARIZED, &l, &pw, &nw);
+
+      CHECK (m == l && (tri == NULL) == (ref == NULL));
+      if (tri && ref)
+      {
+	CHECK (same (tri, ref, m));
+	CHECK (nv == nw && memcmp (pv, pw, sizeof (double [3]) * nv) == 0);
+	if (j) CHECK ((char*) tri > (char*) arena.blocks && (char*) (pv + 3*nv) <= arena.top); /* a single block */
+      }
+
+      free (ref);
+    }
+
+    if (j) CHECK (arena.size == size);
+    else size = arena.size;
+  }
+
+  ARENA_Release (&arena);
+}
+
+/* a polytope sliding through another, and a box sliding into face contact with another
+ * and then sideways within a thin overlap: the cached intersection equals the full one
+ * at every step, for both kinds, and the cache is reused, also for the thin overlap of
+ * NON_REGULARIZED (which REGULARIZED drops); near degenerate steps may differ in slivers,
+ * and NON_REGULARIZED ones in the swelling of the planes passing near the interior point,
+ * both of volume below the epsilon times the surface area */
+static void cached_sliding (void)
+{
+  double c [3] = {0.0, 0.0, 0.0}, h [3] = {1.0, 1.0, 1.0}, o [3] = {0.0, 0.0, 0.0};
+  double d [3], x [24], y [24], px [36], py [36], *v, *p, *pv, *pw, t;
+  int i, j, k, m, l, nv, nw, hits, steps = 200;
+  CVIKIND kind [2] = {REGULARIZED, NON_REGULARIZED};
+  double tol [2] = {1E-8, 10.0 * GEOMETRIC_EPSILON};
+  CVICACHE cache;
+  TRI *tri, *ref;
+
+  v = malloc (sizeof (double [3]) * nvb [0]);
+  p = malloc (sizeof (double [6]) * npb [0]);
+  tst_direction (d);
+  box (c, h, o, x, px);
+
+  for (k = 0; k < 2; k ++)
+  {
+    cvi_cache_init (&cache);
+
+    for (i = 0; i <= steps; i ++)
+    {
+      t = 2.5 - 5.0 * i / steps;
+      for (j = 0; j < nvb [0]; j ++) ADDMUL (&vb [0][3*j], t, d, &v [3*j]);
+      for (j = 0; j < npb [0]; j ++)
+      {
+	COPY (&pb [0][6*j], &p [6*j]);
+	ADDMUL (&pb [0][6*j+3], t, d, &p [6*j+3]);
+      }
+
+      tri = cvi_cached (&cache, va [0], nva [0], pa [0], npa [0], v, nvb [0], p, npb [0], kind [k], &m, &pv, &nv, NULL);
+      ref = cvi (va [0], nva [0], pa [0], npa [0], v, nvb [0], p, npb [0], kind [k], &l, &pw, &nw);
+      CHECK ((tri == NULL) == (ref == NULL));
+      CHECK_CLOSE (tst_volume (tri, m), tst_volume (ref, l), tol [k]);
+      free (ref);
+      free (tri);
+    }
+
+    CHECK (cache.hits > 0);
+    cvi_cache_free (&cache);
+    cvi_cache_init (&cache);
+
+    for (i = 0; i <= 20; i ++)
+    {
+      c [0] = i <= 10 ? 1.5 + 0.05 * i : 2.0 - GEOMETRIC_EPSILON; /* face contact, then a thin overlap */
+      c [1] = i <= 10 ? 0.0 : 0.05 * (i - 10); /* sliding sideways */
+      box (c, h, o, y, py);
+      tri = cvi_cached (&cache, x, 8, px, 6, y, 8, py, 6, kind [k], &m, &pv, &nv, NULL);
+      ref = cvi (x, 8, px, 6, y, 8, py, 6, kind [k], &l, &pw, &nw);
+      CHECK ((tri == NULL) == (ref == NULL) && m == l && nv == nw);
+      CHECK_CLOSE (tst_volume (tri, m), tst_volume (ref, l), tol [k]);
+      if (i > 10 && kind [k] == REGULARIZED) CHECK (tri == NULL);
+      else CHECK_CLOSE (tst_volume (tri, m), 2.0 * (2.0 - c [0]) * (2.0 - c [1]), tol [k]);
+      if (i == 10) hits = cache.hits;
+      free (ref);
+      free (tri);
+    }
+
+    if (kind [k] == NON_REGULARIZED) CHECK (cache.hits - hits >= 9); /* the thin overlap is reused */
+    CHECK (hits > 0);
+    cvi_cache_free (&cache);
+    c [0] = c [1] = 0.0;
+  }
+
+  free (p);
+  free (v);
+}
+
+/* thin plates crossing at small angles, where cyclic projections converge slowly:
+ * the k-way intersection is empty only if the running pairwise one is empty, and
+ * otherwise the centroid of the result is inside of all plates */
+static void multi_thin (void)
+{
+  double v [3][24], p [3][36], q [72], c [3], h [3], o [3], x [3], d, *pv;
+  int i, j, l, m, n, nv, np, used [12], found = 0;
+  CVICONVEX cvx [3];
+  TRI *tri, *ref, *r;
+
+  srand (5);
+
+  for (l = 0; l < 2000; l ++)
+  {
+    for (j = 0; j < 3; j ++)
+    {
+      tst_direction (c);
+      SCALE (c, DRANDEXT (0.0, 0.3));
+      h [0] = h [1] = 1.0;
+      h [2] = DRANDEXT (1E-3, 1E-2);
+      tst_direction (o);
+      SCALE (o, DRANDEXT (0.0, 0.05));
+      box (c, h, o, v [j], p [j]);
+      cvx [j].v = v [j]; cvx [j].nv = 8;
+      cvx [j].p = p [j]; cvx [j].np = 6;
+    }
+
+    tri = cvi_multi (cvx, 3, NON_REGULARIZED, &m, NULL, NULL, NULL);
+
+    ref = NULL;
+    if ((r = cvi (v [0], 8, p [0], 6, v [1], 8, p [1], 6, NON_REGULARIZED, &n, &pv, &nv)))
+    {
+      for (i = np = 0, memset (used, 0, sizeof (used)); i < n; i ++) /* planes of 'r', each once */
+      {
+	j = r [i].flg > 0 ? r [i].flg - 1 : 5 - r [i].flg;
+	if (used [j]) continue;
+	used [j] = 1;
+	COPY6 (j < 6 ? p [0] + 6*j : p [1] + 6*(j-6), q + 6*np);
+	np ++;
+      }
+      ref = cvi (pv, nv, q, np, v [2], 8, p [2], 6, NON_REGULARIZED, &n, NULL, NULL);
+    }
+
+    CHECK ((tri == NULL) == (ref == NULL));
+
+    if (tri)
+    {
+      TRI_Char (tri, m, c);
+      for (j = 0, d = -DBL_MAX; j < 3; j ++)
+	for (i = 0; i < 6; i ++) { SUB (c, p [j] + 6*i + 3, x); d = MAX (d, DOT (p [j] + 6*i, x)); }
+      CHECK (d <= GEOMETRIC_EPSILON);
+      found ++;
+    }
+
+    free (ref);
+    free (tri);
+    free (r);
+  }
+
+  CHECK (found > 0);
+}
+
+/* is 'x' within 'tol' inside of the planes (p, np) */
+static int inside (double *p, int np, double *x, double tol)
+{
+  double d [3];
+  int i;
+
+  for (i = 0; i < np; i ++)
+  {
+    SUB (x, p + 6*i + 3, d);
+    if (DOT (p + 6*i, d) > tol) return 0;
+  }
+
+  return 1;
+}
+
+/* add to 'x' the vertices of 'a' inside of 'b' and the points where the
+ * segments between vertices of 'a' cross the planes of 'b' inside of 'b' */
+static int clip (double *va, int nva, double *pb, int npb, double *x, double tol)
+{
+  double *a, *b, *p, u [3], w [3], s, t;
+  int i, j, l, n;
+
+  for (i = n = 0; i < nva; i ++)
+  {
+    a = va + 3*i;
+    if (inside (pb, npb, a, tol)) { COPY (a, x + 3*n); n ++; }
+
+    for (j = i + 1; j < nva; j ++)
+    {
+      b = va + 3*j;
+      for (l = 0; l < npb; l ++)
+      {
+	p = pb + 6*l;
+	SUB (a, p + 3, u);
+	SUB (b, p + 3, w);
+	s = DOT (p, u);
+	t = DOT (p, w);
+	if ((s < 0.0) == (t < 0.0)) continue;
+	SUB (b, a, w);
+	ADDMUL (a, s / (s - t), w, u);
+	if (inside (pb, npb, u, tol)) { COPY (u, x + 3*n); n ++; }
+      }
+    }
+  }
+
+  return n;
+}
+
+/* the volume of the intersection with culled planes agrees with an independent
+ * reference: the hull of the vertices of one polytope inside of the other
+ * and of the crossings of vertex segments of one with the planes of the other */
+static void culled_volume (void)
+{
+  double *x, vol;
+  int i, n, m, l = 0, culled, total;
+  TRI *tri, *ref;
+
+  for (i = total = 0; i < NPAIRS; i ++)
+  {
+    tri = cvi_arena (va [i], nva [i], pa [i], npa [i], vb [i], nvb [i], pb [i], npb [i], REGULARIZED, &m, NULL, NULL, &culled, NULL);
+    total += culled;
+
+    n = nva [i] * (1 + nva [i] * npb [i]) + nvb [i] * (1 + nvb [i] * npa [i]);
+    x = malloc (sizeof (double [3]) * n);
+    n = clip (va [i], nva [i], pb [i], npb [i], x, 1E-10);
+    n += clip (vb [i], nvb [i], pa [i], npa [i], x + 3*n, 1E-10);
+    ref = n >= 4 ? hull (x, n, &l) : NULL;
+    vol = tst_volume (ref, l);
+
+    CHECK (culled >= 0 && culled < npa [i] + npb [i]);
+    if (vol > 1E-6) CHECK_CLOSE (tst_volume (tri, m), vol, 1E-9);
+    else CHECK (tst_volume (tri, m) < 1E-5);
+
+    free (ref);
+    free (tri);
+    free (x);
+  }
+
+  CHECK (total > 0);
+}
+
+/* is the adjacency of an indexed mesh closed and consistent with its vertex indices */
+static int closed (TRIMESH *mesh)
+{
+  int h, g, j, a, b;
+
+  for (h = 0; h < 3 * mesh->nt; h ++)
+  {
+    a = mesh->tri [h];
+    b = mesh->tri [h % 3 < 2 ? h + 1 : h - 2];
+    if ((g = mesh->adj [h]) < 0) return 0;
+    for (j = 0; j < 3; j ++) if (mesh->tri [3*g+j] == b && mesh->tri [3*g+(j+1)%3] == a) break;
+    if (j == 3) return 0;
+  }
+
+  return 1;
+}
+
+/* intersection mesh output straight from the polar faces agrees with 'cvi' */
+static void mesh_direct (void)
+{
+  double c [3], e [9], *x, *y;
+  int i, j, l, m;
+  TRIMESH *mesh;
+  TRI *tri;
+
+  for (i = 0; i < NPAIRS; i ++)
+  {
+    tri = cvi (va [i], nva [i], pa [i], npa [i], vb [i], nvb [i], pb [i], npb [i], NON_REGULARIZED, &m, NULL, NULL);
+    mesh = cvi_mesh (va [i], nva [i], pa [i], npa [i], vb [i], nvb [i], pb [i], npb [i], NON_REGULARIZED);
+    CHECK ((tri == NULL) == (mesh == NULL));
+
+    if (tri && mesh)
+    {
+      CHECK (mesh->nt == m);
+      for (j = 0; j < m; j ++)
+      {
+	CHECK (mesh->flg [j] == tri [j].flg);
+	for (l = 0; l < 3; l ++)
+	{
+	  x = &mesh->ver [3 * mesh->tri [3*j+l]];
+	  y = tri [j].ver [l];
+	  CHECK (x [0] == y [0] && x [1] == y [1] && x [2] == y [2]);
+	}
+      }
+      CHECK (closed (mesh));
+      CHECK_CLOSE (TRI_Meshmass (mesh, c, e), tst_volume (tri, m), 1E-12);
+    }
+
+    free (mesh);
+    free (tri);
+  }
+}
+
+/* box of half sizes (3, 3, 3) in the frame R whose upper face lies at the
+ * height 'z' above 'c' along the third column of R; output its surface */
+static TRI* slab (double *c, double *omega, double z, double *v, int *m)
+{
+  double R [9], h [3] = {3.0, 3.0, 3.0}, o [3], p [36];
+
+  EXPMAP (omega, R);
+  ADDMUL (c, z - 3.0, R+6, o);
+  box (o, h, omega, v, p);
+
+  return hull (v, 8, m);
+}
+
+/* volume of a unit ball below the plane at the height 'z' */
+static double ball_below (double z)
+{
+  return ALG_PI * (z + 1.0) * (z + 1.0) * (2.0 - z) / 3.0;
+}
+
+/* sphere clipped by a half-space against the ball segment formulas */
+static void sphere_segment (void)
+{
+  double c [3] = {0.3, -0.2, 0.1}, omega [3] = {0.4, -0.7, 0.2}, R [9], v [24], r = 0.8, z;
+  double zs [] = {0.0, 0.4, -0.6, 0.95};
+  CVIPATCH patch;
+  TRI *tri;
+  int i, m;
+
+  EXPMAP (omega, R);
+
+  for (i = 0; i < 4; i ++)
+  {
+    z = zs [i];
+    tri = slab (c, omega, z * r, v, &m);
+    CHECK_CLOSE (cvi_sphere (tri, m, v, 8, c, r, &patch), r*r*r * ball_below (z), 1E-10);
+    CHECK_CLOSE (patch.area, ALG_PI * r*r * (1.0 - z*z), 1E-10);
+    CHECK_CLOSE (DOT (patch.normal, R+6), 1.0, 1E-10);
+    CHECK_CLOSE (patch.point [0], c [0] + z*r*R [6], 1E-10);
+    CHECK_CLOSE (patch.point [1], c [1] + z*r*R [7], 1E-10);
+    CHECK_CLOSE (patch.point [2], c [2] + z*r*R [8], 1E-10);
+    free (tri);
+  }
+
+  tri = slab (c, omega, 2.0, v, &m); /* ball inside of the box */
+  CHECK_CLOSE (cvi_sphere (tri, m, v, 8, c, r, &patch), 4.0 * ALG_PI * r*r*r / 3.0, 1E-10);
+  CHECK (patch.area == 0.0 && LEN (patch.normal) == 0.0);
+  free (tri);
+
+  tri = slab (c, omega, -1.5, v, &m); /* separated */
+  CHECK (cvi_sphere (tri, m, v, 8, c, r, &patch) == 0.0);
+  CHECK (patch.area == 0.0);
+  CHECK_CLOSE (DOT (patch.normal, R+6), 1.0, 1E-10);
+  free (tri);
+}
+
+/* ellipsoid clipped by a plane normal to its third axis: an affinely scaled ball segment */
+static void ellip_segment (void)
+{
+  double c [3] = {-0.1, 0.5, 0.2}, omega [3] = {-0.3, 0.6, 0.9}, sca [3] = {0.5, 1.0, 1.5};
+  double R [9], v [24], zs [] = {0.0, 0.5, -0.3}, z;
+  CVIPATCH patch;
+  TRI *tri;
+  int i, m;
+
+  EXPMAP (omega, R);
+
+  for (i = 0; i < 3; i ++)
+  {
+    z = zs [i];
+    tri = slab (c, omega, z * sca [2], v, &m);
+    CHECK_CLOSE (cvi_ellip (tri, m, v, 8, c, sca, R, &patch), sca[0]*sca[1]*sca[2] * ball_below (z), 1E-10);
+    CHECK_CLOSE (patch.area, ALG_PI * sca[0]*sca[1] * (1.0 - z*z), 1E-10);
+    CHECK_CLOSE (DOT (patch.normal, R+6), 1.0, 1E-10);
+    CHECK_CLOSE (patch.point [0], c [0] + z*sca[2]*R [6], 1E-10);
+    CHECK_CLOSE (patch.point [1], c [1] + z*sca[2]*R [7], 1E-10);
+    CHECK_CLOSE (patch.point [2], c [2] + z*sca[2]*R [8], 1E-10);
+    free (tri);
+  }
+}
+
+/* 'n' points of the Fibonacci lattice on the sphere (c, r) and their hull */
+static TRI* globe (double *c, double r, int n, double *v, int *m)
+{
+  double d [3], z, s, a;
+  int i;
+
+  for (i = 0; i < n; i ++)
+  {
+    z = 1.0 - (2.0*i + 1.0) / n;
+    s = sqrt (1.0 - z*z);
+    a = ALG_PI * (3.0 - sqrt (5.0)) * i;
+    d [0] = s * cos (a);
+    d [1] = s * sin (a);
+    d [2] = z;
+    ADDMUL (c, r, d, &v [3*i]);
+  }
+
+  return hull (v, n, m);
+}
+
+/* lens of a tessellated and an exact sphere of equal radii against the analytic lens
+ * and against 'cvi' of two tessellated spheres; the inscribed tessellations only lose volume */
+static void sphere_lens (void)
+{
+  double ca [3] = {0.1, 0.2, 0.3}, cb [3], r = 1.2, ds [] = {0.3, 1.0, 1.9}, *va, *vb, *pa, *pb, d, lens, vol, ref;
+  int i, j, n = 4000, ma, mb, nc, npa, npb;
+  CVIPATCH patch;
+  TRI *ta, *tb, *tc;
+
+  va = malloc (sizeof (double [6]) * n);
+  vb = va + 3*n;
+  ta = globe (ca, r, n, va, &ma);
+  for (j = 0; j < ma; j ++) NORMALIZE (ta [j].out);
+  pa = TRI_Planes (ta, ma, &npa);
+
+  for (i = 0; i < 3; i ++)
+  {
+    d = ds [i];
+    cb [0] = ca [0] + d * 0.6;
+    cb [1] = ca [1];
+    cb [2] = ca [2] - d * 0.8;
+    lens = ALG_PI * (4.0*r + d) * (2.0*r - d) * (2.0*r - d) / 12.0;
+
+    vol = cvi_sphere (ta, ma, va, n, cb, r, &patch);
+    CHECK (vol <= lens);
+    CHECK_CLOSE (vol / lens, 1.0, 2E-3);
+    CHECK_CLOSE (patch.area / (2.0 * ALG_PI * r * (r - 0.5*d)), 1.0, 2E-3);
+
+    tb = globe (cb, r, n, vb, &mb);
+    for (j = 0; j < mb; j ++) NORMALIZE (tb [j].out);
+    pb = TRI_Planes (tb, mb, &npb);
+    tc = cvi (va, n, pa, npa, vb, n, pb, npb, NON_REGULARIZED, &nc, NULL, NULL);
+    ref = tst_volume (tc, nc);
+    CHECK (ref <= vol);
+    CHECK_CLOSE (ref / vol, 1.0, 2E-3);
+
+    free (tc);
+    free (pb);
+    free (tb);
+  }
+
+  free (pa);
+  free (ta);
+  free (va);
+}
+
+int main (int argc, char **argv)
+{
+  pairs ();
+
+  RUN (batch);
+  RUN (arena_reuse);
+  RUN (cached_sliding);
+  RUN (culled_volume);
+  RUN (multi_thin);
+  RUN (mesh_direct);
+  RUN (sphere_segment);
+  RUN (ellip_segment);
+  RUN (sphere_lens);
+
+  return DONE ();
+}
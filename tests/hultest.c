@@ -0,0 +1,462 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Tomasz Koziara
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * hultest.c: convex hull tests
+ */
+
+#include "tst.h"
+
+/* mark the points of 'v' referenced by the hull (tri, m) */
+static void marked (TRI *tri, int m, double *v, int n, char *mark)
+{
+  int i, j;
+
+  memset (mark, 0, n);
+  for (i = 0; i < m; i ++)
+    for (j = 0; j < 3; j ++) mark [(tri [i].ver [j] - v) / 3] = 1;
+}
+
+/* points in a box with its corners last: the pre-filter drops all interior points
+ * and the hull equals the one built incrementally from an unfiltered start */
+static void box_filter (void)
+{
+  double *v, *x, ext [3] = {1.0, 2.0, 3.0};
+  char *a, *b;
+  int i, n = 1000, k = 8, m, l, c;
+  HULLSTATS stats;
+  TRI *tri, *ref;
+  HULL *hl;
+
+  v = malloc (sizeof (double [3]) * n);
+  a = malloc (n);
+  b = malloc (n);
+
+  srand (2);
+
+  for (i = 0, x = v; i < n - k; i ++, x += 3)
+  {
+    x [0] = DRANDEXT (0.01, 0.99) * ext [0];
+    x [1] = DRANDEXT (0.01, 0.99) * ext [1];
+    x [2] = DRANDEXT (0.01, 0.99) * ext [2];
+  }
+  for (c = 0; c < k; c ++, x += 3)
+  {
+    x [0] = c & 1 ? ext [0] : 0.0;
+    x [1] = c & 2 ? ext [1] : 0.0;
+    x [2] = c & 4 ? ext [2] : 0.0;
+  }
+
+  tri = hull_stats (v, n, &m, NULL, &stats);
+  CHECK (tri != NULL);
+  CHECK (stats.input == n);
+  CHECK (stats.dropped == n - k); /* all interior points */
+
+  hl = hull_create (v, HULL_FILTER_MIN - 1); /* below the pre-filter threshold */
+  CHECK (hl != NULL);
+  CHECK (hull_insert (hl, v + 3*(HULL_FILTER_MIN - 1), n - HULL_FILTER_MIN + 1));
+  ref = hull_tri (hl, &l);
+
+  marked (tri, m, v, n, a);
+  marked (ref, l, v, n, b);
+  CHECK (memcmp (a, b, n) == 0);
+  for (i = n - k, c = 0; i < n; i ++) c += a [i];
+  CHECK (c == k);
+  CHECK (m == l && m == 12);
+  CHECK_CLOSE (tst_volume (tri, m), tst_volume (ref, l), 1E-12);
+  CHECK_CLOSE (tst_volume (tri, m), ext [0] * ext [1] * ext [2], 1E-12);
+
+  hull_destroy (hl);
+  free (ref);
+  free (tri);
+  free (b);
+  free (a);
+  free (v);
+}
+
+/* chunked hull of points on a sphere (probe fallback) and in a ball agrees with 'hull' */
+static void parallel (void)
+{
+  double *v, *x, r;
+  int i, s, n = 4 * HULL_CHUNK_MIN, m, l;
+  char *a, *b;
+  TRI *tri, *ref;
+
+  v = malloc (sizeof (double [3]) * n);
+  a = malloc (n);
+  b = malloc (n);
+
+  srand (3);
+
+  for (s = 0; s < 2; s ++)
+  {
+    for (i = 0, x = v; i < n; i ++, x += 3)
+    {
+      tst_direction (x);
+      r = s ? cbrt (DRAND ()) : 1.0;
+      SCALE (x, r);
+    }
+
+    ref = hull (v, n, &l);
+    tri = hull_parallel (v, n, &m, 4);
+    CHECK (tri && ref);
+    marked (tri, m, v, n, a);
+    marked (ref, l, v, n, b);
+    CHECK (memcmp (a, b, n) == 0);
+    CHECK_CLOSE (tst_volume (tri, m), tst_volume (ref, l), 1E-12);
+    free (ref);
+    free (tri);
+  }
+
+  free (b);
+  free (a);
+  free (v);
+}
+
+/* hull mesh output straight from the hull faces equals the converted hull table */
+static void mesh_direct (void)
+{
+  double *v, *x, r;
+  int i, s, n = 2000, m;
+  TRIMESH *a, *b;
+  TRI *tri;
+
+  v = malloc (sizeof (double [3]) * n);
+
+  srand (6);
+
+  for (s = 0; s < 2; s ++)
+  {
+    for (i = 0, x = v; i < n; i ++, x += 3)
+    {
+      tst_direction (x);
+      r = s ? cbrt (DRAND ()) : 1.0;
+      SCALE (x, r);
+    }
+
+    a = hull_mesh (v, n);
+    tri = hull (v, n, &m);
+    b = TRI_Tomesh (tri, m, v, n);
+
+    CHECK (a->nv == b->nv && a->nt == b->nt);
+    CHECK (memcmp (a->ver, b->ver, sizeof (double [3]) * a->nv) == 0);
+    CHECK (memcmp (a->nl, b->nl, sizeof (double [3]) * a->nt) == 0);
+    CHECK (memcmp (a->tri, b->tri, sizeof (int [3]) * a->nt) == 0);
+    CHECK (memcmp (a->adj, b->adj, sizeof (int [3]) * a->nt) == 0);
+    CHECK (memcmp (a->flg, b->flg, sizeof (int) * a->nt) == 0);
+
+    free (tri);
+    free (b);
+    free (a);
+  }
+
+  free (v);
+}
+
+/* approximate hulls: at least the initial simplex, then at most 'k' vertices
+ * with a growing volume, and the complete hull when unbounded */
+static void approx (void)
+{
+  double *v, *x, vol, prev, c [3];
+  int i, k, n = 5000, m, l, nv;
+  TRI *tri, *ref;
+
+  v = malloc (sizeof (double [3]) * n);
+
+  srand (10);
+
+  for (i = 0, x = v; i < n; i ++, x += 3) tst_direction (x);
+
+  for (k = 1, prev = 0.0; k <= 400; k = k < 4 ? k + 1 : 2*k)
+  {
+    tri = hull_approx (v, n, k, 0.0, 0, &m);
+    CHECK (tri != NULL);
+    free (TRI_Vertices (tri, m, &nv));
+    CHECK (nv == MAX (k, 4));
+    vol = TRI_Char (tri, m, c);
+    CHECK (vol >= prev);
+    prev = vol;
+    free (tri);
+  }
+
+  tri = hull_approx (v, n, 0, 0.0, 0, &m);
+  ref = hull (v, n, &l);
+  CHECK (m == l);
+  CHECK_CLOSE (tst_volume (tri, m), tst_volume (ref, l), 1E-12);
+
+  free (ref);
+  free (tri);
+  free (v);
+}
+
+/* do all points 'v' lie within 'tol' below the planes of the hull (tri, m),
+ * whose adjacency is consistent */
+static int encloses (TRI *tri, int m, double *v, int n, double tol)
+{
+  double q [3];
+  int i, j, k;
+  TRI *a;
+
+  for (i = 0; i < m; i ++)
+  {
+    for (j = 0; j < 3; j ++)
+    {
+      a = tri [i].adj [j];
+      for (k = 0; k < 3; k ++) if (a->adj [k] == &tri [i]) break;
+      if (k == 3) return 0;
+    }
+
+    for (j = 0; j < n; j ++)
+    {
+      SUB (&v [3*j], tri [i].ver [0], q);
+      if (DOT (tri [i].out, q) > tol * LEN (tri [i].out)) return 0;
+    }
+  }
+
+  return 1;
+}
+
+/* points inserted into an incremental hull in batches and one by one, including interior
+ * points, duplicates and near duplicates of its vertices: the hull equals 'hull' of the
+ * points inserted so far after every step */
+static void incremental (void)
+{
+  double *v, *x, r;
+  int i, j, n = 3000, b = 100, m, l;
+  TRI *tri, *ref;
+  HULL *hl;
+
+  v = malloc (sizeof (double [3]) * n);
+
+  srand (12);
+
+  for (i = 0, x = v; i < n; i ++, x += 3)
+  {
+    switch ((i / b) % 4)
+    {
+    case 0:
+    case 1:
+      tst_direction (x);
+      r = DRANDEXT (0.9, 1.0);
+      SCALE (x, r);
+    break;
+    case 2: /* interior */
+      tst_direction (x);
+      r = 0.5 * DRAND ();
+      SCALE (x, r);
+    break;
+    case 3: /* duplicates and near duplicates of earlier points */
+      j = rand () % i;
+      COPY (&v [3*j], x);
+      if (i & 1) { x [0] += 1E-13; x [2] -= 1E-13; }
+    break;
+    }
+  }
+
+  hl = hull_create (v, b);
+  CHECK (hl != NULL);
+
+  for (i = b; i < n; i += j)
+  {
+    j = (i / b) % 2 ? 1 : b; /* single points and batches */
+    CHECK (hull_insert (hl, v + 3*i, j));
+
+    if ((i + j) % b == 0)
+    {
+      tri = hull_tri (hl, &m);
+      ref = hull (v, i + j, &l);
+      CHECK (encloses (tri, m, v, i + j, 1E-10));
+      CHECK_CLOSE (tst_volume (tri, m), tst_volume (ref, l), 1E-12);
+      free (ref);
+      free (tri);
+    }
+  }
+
+  hull_destroy (hl);
+  free (v);
+}
+
+/* points in a box with its corners last merge into its 6 faces and 8 corners; noisy
+ * flat clouds, whose merged faces may wrap around the rim, pinch their boundaries or
+ * take in the whole hull, merge into unit planes and valid loops of corner indices */
+static void merge_faces (void)
+{
+  double *v, *x, ext [3] = {1.0, 2.0, 3.0}, tol [] = {0.01, 0.03, 0.1, 0.3};
+  int i, j, k, l, n = 1000, c, ok;
+  HULLPOLY *poly;
+
+  v = malloc (sizeof (double [3]) * n);
+
+  srand (13);
+
+  for (i = 0, x = v; i < n - 8; i ++, x += 3)
+  {
+    for (j = 0; j < 3; j ++) x [j] = DRAND () * ext [j];
+    j = i % 3;
+    x [j] = i & 1 ? ext [j] : 0.0; /* on a face */
+  }
+  for (c = 0; c < 8; c ++, x += 3)
+  {
+    x [0] = c & 1 ? ext [0] : 0.0;
+    x [1] = c & 2 ? ext [1] : 0.0;
+    x [2] = c & 4 ? ext [2] : 0.0;
+  }
+
+  poly = hull_polygons (v, n, 1E-9);
+  CHECK (poly && poly->nf == 6 && poly->nv == 8);
+  for (i = 0; i < 6; i ++) CHECK (poly->face [i+1] - poly->face [i] == 4);
+  free (poly);
+
+  for (k = 0; k < 4; k ++)
+  {
+    for (l = 0; l < 50; l ++)
+    {
+      c = 50 + rand () % (n - 50);
+      for (i = 0, x = v; i < c; i ++, x += 3) { tst_direction (x); x [2] *= 0.05; }
+
+      poly = hull_polygons (v, c, tol [k]);
+      CHECK (poly != NULL);
+      for (i = 0, ok = 1; i < poly->nf; i ++)
+      {
+	x = poly->pla + 6*i;
+	ok = ok && fabs (LEN (x) - 1.0) < 1E-10;
+	for (j = poly->face [i]; j < poly->face [i+1]; j ++) ok = ok && poly->loop [j] >= 0 && poly->loop [j] < poly->nv;
+      }
+      CHECK (ok);
+      free (poly);
+    }
+  }
+
+  free (v);
+}
+
+/* repeated small hulls from a reused workspace equal 'hull', and after a first round
+ * the output arena serves a second round of the same hulls without growing */
+static void workspace (void)
+{
+  double *v, *x, r;
+  int i, j, k, n, m, l, ok;
+  TRI *tri, *ref;
+  HULLWORK *work;
+  ARENA arena;
+  size_t size = 0;
+
+  v = malloc (sizeof (double [3]) * 200);
+  work = hull_work_create ();
+  ARENA_Init (&arena, 0);
+
+  for (k = 0; k < 2; k ++)
+  {
+    srand (14);
+
+    for (j = 0; j < 100; j ++)
+    {
+      n = 8 + rand () % 192; /* below and above HULL_FILTER_MIN */
+      for (i = 0, x = v; i < n; i ++, x += 3)
+      {
+	tst_direction (x);
+	r = j & 1 ? cbrt (DRAND ()) : 1.0;
+	SCALE (x, r);
+      }
+
+      ARENA_Reset (&arena);
+      tri = hull_work (work, v, n, &m, &arena);
+      ref = hull (v, n, &l);
+      CHECK (tri && ref && m == l);
+      for (i = 0, ok = 1; i < m; i ++)
+	ok = ok && tri [i].ver [0] == ref [i].ver [0] && tri [i].ver [1] == ref [i].ver [1] &&
+	     tri [i].ver [2] == ref [i].ver [2] && tri [i].adj [0] - tri == ref [i].adj [0] - ref;
+      CHECK (ok);
+      free (ref);
+
+      tri = hull_work (work, v, n, &m, NULL); /* heap output */
+      CHECK (m == l);
+      free (tri);
+    }
+
+    if (k) CHECK (arena.size == size);
+    else size = arena.size;
+  }
+
+  ARENA_Release (&arena);
+  hull_work_destroy (work);
+  free (v);
+}
+
+/* the plane filtered orientation resolves nearly all tests for points in general position,
+ * while the coplanar points of a grid fall back to the exact test and keep the hull exact */
+static void filtered_orient (void)
+{
+  double *v, *x, r;
+  int i, n = 5000, g = 7, m;
+  HULLSTATS stats;
+  TRI *tri;
+
+  v = malloc (sizeof (double [3]) * n);
+
+  srand (15);
+
+  for (i = 0, x = v; i < n; i ++, x += 3)
+  {
+    tst_direction (x);
+    r = cbrt (DRAND ());
+    SCALE (x, r);
+  }
+
+  tri = hull_stats (v, n, &m, NULL, &stats);
+  CHECK (tri && stats.faces == m);
+  CHECK (stats.orient > 0 && stats.exact * 100 < stats.orient);
+  CHECK (encloses (tri, m, v, n, 1E-12));
+  free (tri);
+
+  for (i = 0, x = v; i < g*g*g; i ++, x += 3)
+  {
+    x [0] = 0.1 * (i % g);
+    x [1] = 0.1 * (i / g % g);
+    x [2] = 0.1 * (i / (g*g));
+  }
+
+  tri = hull_stats (v, g*g*g, &m, NULL, &stats);
+  CHECK (tri != NULL);
+  CHECK (stats.exact > 0 && stats.exact <= stats.orient);
+  CHECK (encloses (tri, m, v, g*g*g, 1E-12));
+  CHECK_CLOSE (tst_volume (tri, m), 0.216, 1E-12);
+  free (tri);
+
+  free (v);
+}
+
+int main (int argc, char **argv)
+{
+  RUN (box_filter);
+  RUN (parallel);
+  RUN (mesh_direct);
+  RUN (approx);
+  RUN (incremental);
+  RUN (merge_faces);
+  RUN (workspace);
+  RUN (filtered_orient);
+
+  return DONE ();
+}
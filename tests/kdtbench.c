@@ -0,0 +1,79 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Tomasz Koziara
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * kdtbench.c: kd-tree construction benchmark
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#if OPENMP
+#include <omp.h>
+#endif
+#include "alg.h"
+#include "kdt.h"
+
+#if OPENMP
+#define SECONDS() omp_get_wtime ()
+#else
+#define SECONDS() ((double) clock () / CLOCKS_PER_SEC)
+#endif
+
+/* time KDT_Create and k nearest queries for 10^5 ... 'max' (10^7 by default) random points */
+int main (int argc, char **argv)
+{
+  double *p, *x, *dist, t0, t1, t2;
+  int i, n, max, k = 8, nq = 100000;
+  KDT *kd, **nodes;
+
+  max = argc > 1 ? atoi (argv [1]) : 10000000;
+
+  dist = malloc (sizeof (double) * k * nq);
+  nodes = malloc (sizeof (KDT*) * k * nq);
+
+  srand (1);
+
+  for (n = 100000; n <= max; n *= 10)
+  {
+    p = malloc (sizeof (double [3]) * n);
+    for (i = 0, x = p; i < 3*n; i ++, x ++) *x = DRAND ();
+
+    t0 = SECONDS ();
+    kd = KDT_Create (n, p, 0.0);
+    t1 = SECONDS ();
+    KDT_Knearest_Batch (kd, p, nq, k, nodes, dist);
+    t2 = SECONDS ();
+
+    printf ("%9d points: create %8.1f ms, %d x %d nearest %8.1f ms\n", n, 1E3 * (t1 - t0), nq, k, 1E3 * (t2 - t1));
+
+    KDT_Destroy (kd);
+    free (p);
+  }
+
+  free (nodes);
+  free (dist);
+
+  return 0;
+}
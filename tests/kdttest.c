@@ -0,0 +1,392 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Tomasz Koziara
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * kdttest.c: kd-tree tests
+ */
+
+#include <float.h>
+#include "tst.h"
+#include "kdt.h"
+
+typedef struct ref REF; /* reference tree node */
+
+struct ref
+{
+  double p [3];
+
+  int d;
+
+  REF *l, *r;
+};
+
+static int dim; /* sorting dimension */
+
+/* order by the sorting dimension, then lexicographically */
+static int compare (const void *x, const void *y)
+{
+  double *a = *(double**)x, *b = *(double**)y;
+  int i;
+
+  if (a [dim] != b [dim]) return a [dim] < b [dim] ? -1 : 1;
+  for (i = 0; i < 3; i ++) if (a [i] != b [i]) return a [i] < b [i] ? -1 : 1;
+  return 0;
+}
+
+/* sort based split along the most elongated direction */
+static int split (int n, double **q, double *p, int *d)
+{
+  double e [6];
+  int i, j, k, t [2];
+
+  for (i = 0; i < 3; i ++) e [i] = e [i+3] = q [0][i];
+  for (j = 1; j < n; j ++)
+    for (i = 0; i < 3; i ++) { e [i] = MIN (e [i], q [j][i]); e [i+3] = MAX (e [i+3], q [j][i]); }
+  for (i = 0; i < 3; i ++) e [i+3] -= e [i];
+
+  if (e [3] >= e [4] && e [3] >= e [5]) *d = 0;
+  else if (e [4] >= e [3] && e [4] >= e [5]) *d = 1;
+  else *d = 2;
+
+  for (k = i = 0; k < 3; k ++) if (k != *d) t [i ++] = k;
+
+  for (i = 0; ; )
+  {
+    dim = *d;
+    qsort (q, n, sizeof (double*), compare);
+
+    for (k = 0, j = -1; k < n; k ++) /* last of the run ending at or after n/2 */
+    {
+      if (k > 0 && q [k-1][*d] < q [k][*d])
+      {
+	if (k >= n/2) { k --; break; }
+	else j = k - 1;
+      }
+    }
+    if (k == n && j >= 0) k = j;
+
+    if (k < n || i == 2) break;
+    *d = t [i ++];
+  }
+
+  if (k == n) { COPY (q [0], p); return -1; }
+  else { COPY (q [k], p); return k; }
+}
+
+static REF* create (int n, double **q)
+{
+  REF *r;
+  int k;
+
+  r = calloc (1, sizeof (REF));
+
+  if (n == 0) { r->d = -1; return r; }
+
+  k = split (n, q, r->p, &r->d);
+
+  if (k == -1)
+  {
+    r->l = create (0, NULL);
+    r->r = create (0, NULL);
+  }
+  else
+  {
+    r->l = create (k, q);
+    r->r = create (n-k-1, q+k+1);
+  }
+
+  return r;
+}
+
+static void destroy (REF *r)
+{
+  if (r->d >= 0) { destroy (r->l); destroy (r->r); }
+  free (r);
+}
+
+/* node by node equality */
+static int same (KDT *kd, REF *r)
+{
+  if (kd->d != r->d) return 0;
+  if (kd->d < 0) return 1;
+  if (kd->p [0] != r->p [0] || kd->p [1] != r->p [1] || kd->p [2] != r->p [2]) return 0;
+  return same (kd->l, r->l) && same (kd->r, r->r);
+}
+
+/* selection based split builds the same tree as the sort based one, for random
+ * points and for grid points with many equal coordinates, regardless of input order */
+static void split_identity (void)
+{
+  int n [] = {1, 2, 3, 7, 100, 1000, 20000}, i, l, s;
+  double *p, *u, **q;
+  KDT *kd, *ku;
+  REF *r;
+
+  srand (4);
+
+  for (s = 0; s < 2; s ++)
+  {
+    for (l = 0; l < (int) (sizeof (n) / sizeof (int)); l ++)
+    {
+      p = malloc (sizeof (double [3]) * n [l]);
+      u = malloc (sizeof (double [3]) * n [l]);
+      q = malloc (sizeof (double*) * n [l]);
+
+      for (i = 0; i < n [l]; i ++)
+      {
+	if (s)
+	{
+	  p [3*i] = i % 29;
+	  p [3*i+1] = (i / 29) % 29;
+	  p [3*i+2] = i / (29*29);
+	}
+	else
+	{
+	  p [3*i] = DRAND ();
+	  p [3*i+1] = DRAND ();
+	  p [3*i+2] = DRAND ();
+	}
+	q [i] = &p [3*i];
+      }
+      for (i = 0; i < n [l]; i ++) COPY (&p [3*(n [l]-1-i)], &u [3*i]); /* reversed */
+
+      kd = KDT_Create (n [l], p, 0.0);
+      ku = KDT_Create (n [l], u, 0.0);
+      r = create (n [l], q);
+      CHECK (same (kd, r));
+      CHECK (same (ku, r));
+
+      KDT_Destroy (kd);
+      KDT_Destroy (ku);
+      destroy (r);
+      free (q);
+      free (u);
+      free (p);
+    }
+  }
+}
+
+/* compare flat subtree 'c' with 'kd' node by node, including the leaf data, and record
+ * the leaves of 'kd' under their flat indices; descendants must follow their parents */
+static int flat_same (KDTFLAT *kf, int c, KDT *kd, KDT **leaf)
+{
+  KDTNODE *x;
+  int i, j;
+
+  if (c < 0)
+  {
+    c = KDT_LEAF (c);
+    if (kd->d >= 0 || leaf [c] || kf->off [c+1] - kf->off [c] != kd->n) return 0;
+    for (i = kf->off [c], j = 0; j < kd->n; i ++, j ++) if (kf->data [i] != kd->data [j]) return 0;
+    leaf [c] = kd;
+    return 1;
+  }
+
+  x = &kf->node [c];
+  if (kd->d != x->d || kd->p [0] != x->p [0] || kd->p [1] != x->p [1] || kd->p [2] != x->p [2]) return 0;
+  for (j = 0; j < 2; j ++) if (x->c [j] >= 0 && x->c [j] <= c) return 0;
+
+  return flat_same (kf, x->c [0], kd->l, leaf) && flat_same (kf, x->c [1], kd->r, leaf);
+}
+
+/* flat kd-tree mirrors the pointer based one and its point, extents and nearest
+ * node queries return the same leaves and nodes */
+static void flat (void)
+{
+  int n [] = {1, 2, 100, 5000}, i, j, k, l, ok, *leaves;
+  double *p, q [3], e [6], r;
+  KDT *kd, *x, **leaf;
+  KDTFLAT *kf;
+  SET *set;
+
+  srand (5);
+
+  for (l = 0; l < (int) (sizeof (n) / sizeof (int)); l ++)
+  {
+    p = malloc (sizeof (double [3]) * n [l]);
+    for (i = 0; i < 3 * n [l]; i ++) p [i] = DRAND ();
+    kd = KDT_Create (n [l], p, 0.0);
+
+    for (i = 0; i < n [l]; i ++)
+    {
+      r = DRANDEXT (0.0, 0.05);
+      for (j = 0; j < 3; j ++) { e [j] = p [3*i+j] - r; e [j+3] = p [3*i+j] + r; }
+      KDT_Drop (kd, e, &p [3*i]);
+    }
+
+    kf = KDT_Flatten (kd);
+    leaf = calloc (kf->nleaf, sizeof (KDT*));
+    leaves = malloc (sizeof (int) * kf->nleaf);
+    CHECK (kf->nnode == n [l] && kf->nleaf == kf->nnode + 1);
+    CHECK (flat_same (kf, kf->nnode ? 0 : KDT_LEAF (0), kd, leaf));
+    for (i = 0, ok = 1; i < kf->nleaf; i ++) ok = ok && leaf [i];
+    CHECK (ok);
+
+    for (i = 0, ok = 1; i < 200; i ++)
+    {
+      for (j = 0; j < 3; j ++) q [j] = DRANDEXT (-0.1, 1.1);
+      ok = ok && leaf [KDT_Pick_Flat (kf, q)] == KDT_Pick (kd, q);
+
+      r = DRANDEXT (0.0, 0.2);
+      for (j = 0; j < 3; j ++) { e [j] = q [j] - r; e [j+3] = q [j] + r; }
+      set = NULL;
+      KDT_Pick_Extents (kd, e, &set);
+      k = KDT_Pick_Extents_Flat (kf, e, leaves);
+      ok = ok && k == SET_Size (set);
+      for (j = 0; j < k; j ++) ok = ok && SET_Contains (set, leaf [leaves [j]], NULL);
+      SET_Free (NULL, &set);
+
+      x = KDT_Nearest (kd, q, r);
+      k = KDT_Nearest_Flat (kf, q, r);
+      ok = ok && (k < 0) == (x == NULL);
+      if (x && k >= 0) ok = ok && x->p [0] == kf->node [k].p [0] && x->p [1] == kf->node [k].p [1] && x->p [2] == kf->node [k].p [2];
+    }
+    CHECK (ok);
+
+    free (leaves);
+    free (leaf);
+    KDT_Destroy_Flat (kf);
+    KDT_Destroy (kd);
+    free (p);
+  }
+}
+
+/* order doubles increasingly */
+static int increasing (const void *x, const void *y)
+{
+  double a = *(double*)x, b = *(double*)y;
+
+  return a < b ? -1 : a > b ? 1 : 0;
+}
+
+/* squared distance between points */
+static double dist2 (double *a, double *b)
+{
+  double c [3];
+
+  SUB (a, b, c);
+
+  return DOT (c, c);
+}
+
+/* k nearest and radius queries, single and batched, agree with the brute force ones
+ * on random points and on grid points, where many distances tie */
+static void proximity (void)
+{
+  int n [] = {1, 7, 2000}, kk [] = {1, 5, 20}, i, j, l, s, k, m, size, cnt, *off, *seen, ok;
+  double *p, *q, *all, *dist, *bdist, r;
+  KDT *kd, *x, **nodes, **bnodes, **list;
+
+  srand (6);
+
+  for (s = 0; s < 2; s ++)
+  {
+    for (l = 0; l < (int) (sizeof (n) / sizeof (int)); l ++)
+    {
+      p = malloc (sizeof (double [3]) * n [l]);
+      for (i = 0; i < n [l]; i ++)
+      {
+	if (s) { p [3*i] = i % 13; p [3*i+1] = (i / 13) % 13; p [3*i+2] = i / 169; }
+	else { p [3*i] = DRAND (); p [3*i+1] = DRAND (); p [3*i+2] = DRAND (); }
+      }
+
+      kd = KDT_Create (n [l], p, 0.0);
+      m = KDT_Size (kd);
+      CHECK (m == n [l]);
+
+      q = malloc (sizeof (double [3]) * 100);
+      all = malloc (sizeof (double) * m);
+      seen = malloc (sizeof (int) * m);
+      nodes = malloc (sizeof (KDT*) * 20);
+      dist = malloc (sizeof (double) * 20);
+      bnodes = malloc (sizeof (KDT*) * 100 * 20);
+      bdist = malloc (sizeof (double) * 100 * 20);
+      list = NULL;
+      size = 0;
+
+      for (i = 0; i < 300; i ++) q [i] = s ? (double) (rand () % 15) - 1.0 : DRANDEXT (-0.1, 1.1);
+      r = s ? 1.5 : 0.15;
+
+      for (k = 0; k < 3; k ++)
+      {
+	KDT_Knearest_Batch (kd, q, 100, kk [k], bnodes, bdist);
+
+	for (i = 0, ok = 1; i < 100; i ++)
+	{
+	  for (x = KDT_First (kd), j = 0; x; x = KDT_Next (x)) all [j ++] = dist2 (&q [3*i], x->p);
+	  qsort (all, m, sizeof (double), increasing);
+	  for (j = 0; j < m; j ++) seen [j] = 0;
+
+	  cnt = KDT_Knearest (kd, &q [3*i], kk [k], nodes, dist);
+	  ok = ok && cnt == MIN (kk [k], m);
+	  for (j = 0; j < cnt; j ++)
+	  {
+	    ok = ok && dist [j] == all [j] && dist2 (&q [3*i], nodes [j]->p) == dist [j] && seen [nodes [j]->n] ++ == 0;
+	    ok = ok && bnodes [i*kk [k]+j] == nodes [j] && bdist [i*kk [k]+j] == dist [j];
+	  }
+	  for (; j < kk [k]; j ++) ok = ok && bnodes [i*kk [k]+j] == NULL && bdist [i*kk [k]+j] == DBL_MAX;
+	}
+	CHECK (ok);
+      }
+
+      off = KDT_Radius_Batch (kd, q, 100, r, &bnodes);
+
+      for (i = 0, ok = 1; i < 100; i ++)
+      {
+	for (x = KDT_First (kd), j = 0; x; x = KDT_Next (x)) j += dist2 (&q [3*i], x->p) <= r*r;
+	for (cnt = 0; cnt < m; cnt ++) seen [cnt] = 0;
+
+	cnt = KDT_Radius (kd, &q [3*i], r, &list, &size);
+	ok = ok && cnt == j && off [i+1] - off [i] == cnt;
+	for (j = 0; j < cnt; j ++)
+	{
+	  ok = ok && dist2 (&q [3*i], list [j]->p) <= r*r && seen [list [j]->n] ++ == 0;
+	  ok = ok && bnodes [off [i]+j] == list [j];
+	}
+      }
+      CHECK (ok);
+
+      free (off);
+      free (bnodes);
+      free (list);
+      free (bdist);
+      free (dist);
+      free (nodes);
+      free (seen);
+      free (all);
+      free (q);
+      KDT_Destroy (kd);
+      free (p);
+    }
+  }
+}
+
+int main (int argc, char **argv)
+{
+  RUN (split_identity);
+  RUN (flat);
+  RUN (proximity);
+
+  return DONE ();
+}
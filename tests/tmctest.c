@@ -0,0 +1,206 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Tomasz Koziara
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * tmctest.c: triangle mesh cache tests
+ */
+
+#include "tst.h"
+#include "tmc.h"
+#include "err.h"
+
+#define PATH "tmctest.tmp"
+#define NMESH 3
+
+/* indexed hull mesh of 'n' points on the sphere (c, r) */
+static TRIMESH* sphere (double *c, double r, int n)
+{
+  double d [3], *v;
+  TRIMESH *mesh;
+  int i, m;
+  TRI *tri;
+
+  v = malloc (sizeof (double [3]) * n);
+
+  for (i = 0; i < n; i ++)
+  {
+    tst_direction (d);
+    ADDMUL (c, r, d, &v [3*i]);
+  }
+
+  tri = hull (v, n, &m);
+  mesh = TRI_Tomesh (tri, m, v, n);
+
+  free (tri);
+  free (v);
+
+  return mesh;
+}
+
+/* read the whole cache file */
+static char* slurp (size_t *size)
+{
+  FILE *f;
+  char *buf;
+
+  f = fopen (PATH, "rb");
+  fseek (f, 0, SEEK_END);
+  *size = ftell (f);
+  rewind (f);
+  buf = malloc (*size);
+  CHECK (fread (buf, 1, *size, f) == *size);
+  fclose (f);
+
+  return buf;
+}
+
+/* write back a modified cache file */
+static void spill (char *buf, size_t size)
+{
+  FILE *f;
+
+  f = fopen (PATH, "wb");
+  CHECK (fwrite (buf, 1, size, f) == size);
+  fclose (f);
+}
+
+/* does the first access to record 'i' throw ERR_FILE_FORMAT */
+static int damaged (int i)
+{
+  volatile int caught = 0;
+  TMC *tmc;
+
+  tmc = TMC_Map (PATH);
+
+  TRY ()
+    TMC_Mesh (tmc, i);
+  CATCH (ERR_FILE_FORMAT)
+    caught = 1;
+  ENDTRY ()
+
+  TMC_Unmap (tmc);
+
+  return caught;
+}
+
+/* mapped records reproduce the written meshes and their mass properties */
+static void roundtrip (void)
+{
+  double c [3] = {1.0, 2.0, 3.0}, m [3], e [9], *pla, *ref;
+  TRIMESH *mesh [NMESH], *x;
+  int i, j, np;
+  TMC *tmc;
+  TRI *tri;
+
+  srand (5);
+
+  for (i = 0; i < NMESH; i ++) mesh [i] = sphere (c, 1.0 + i, 50 + 100*i);
+
+  TMC_Write (mesh, NMESH, PATH);
+  tmc = TMC_Map (PATH);
+  CHECK (tmc->count == NMESH);
+
+  for (i = 0; i < NMESH; i ++)
+  {
+    x = TMC_Mesh (tmc, i);
+    CHECK (x->nv == mesh [i]->nv && x->nt == mesh [i]->nt);
+    CHECK (memcmp (x->ver, mesh [i]->ver, sizeof (double [3]) * x->nv) == 0);
+    CHECK (memcmp (x->tri, mesh [i]->tri, sizeof (int [3]) * x->nt) == 0);
+    CHECK (memcmp (x->adj, mesh [i]->adj, sizeof (int [3]) * x->nt) == 0);
+    CHECK (TMC_Mesh (tmc, i) == x);
+
+    CHECK_CLOSE (tmc->rec [i].volume, TRI_Meshmass (mesh [i], m, e), 1E-12);
+    for (j = 0; j < 3; j ++) CHECK_CLOSE (tmc->rec [i].center [j], m [j], 1E-12);
+
+    tri = TMC_Tri (tmc, i);
+    CHECK (TMC_Tri (tmc, i) == tri);
+    CHECK_CLOSE (tst_volume (tri, x->nt), tmc->rec [i].volume, 1E-12);
+
+    ref = TRI_Planes (tri, x->nt, &np);
+    pla = TMC_Planes (tmc, i);
+    CHECK (np == x->nt);
+    for (j = 0; j < 6 * np; j ++) CHECK_CLOSE (pla [j], ref [j], 1E-12);
+    free (ref);
+  }
+
+  TMC_Unmap (tmc);
+  for (i = 0; i < NMESH; i ++) free (mesh [i]);
+  remove (PATH);
+}
+
+/* out of range vertex or neighbour indices, or array offsets, of a record throw
+ * ERR_FILE_FORMAT on its first access, while the remaining records stay valid */
+static void validation (void)
+{
+  double c [3] = {0.0, 0.0, 0.0};
+  TRIMESH *mesh [NMESH];
+  size_t size, off;
+  TMCREC *rec;
+  char *buf;
+  TMC *tmc;
+  int i, k;
+
+  srand (6);
+
+  for (i = 0; i < NMESH; i ++) mesh [i] = sphere (c, 1.0, 40);
+
+  TMC_Write (mesh, NMESH, PATH);
+  tmc = TMC_Map (PATH);
+  off = (char*) tmc->rec - (char*) tmc->addr; /* records follow the file header */
+  TMC_Unmap (tmc);
+
+  for (k = 0; k < 4; k ++)
+  {
+    TMC_Write (mesh, NMESH, PATH);
+    CHECK (!damaged (1));
+
+    buf = slurp (&size);
+    rec = (TMCREC*) (buf + off);
+
+    switch (k)
+    {
+    case 0: ((int*) (buf + rec [1].tri)) [7] = rec [1].nv; break;
+    case 1: ((int*) (buf + rec [1].tri)) [2] = -1; break;
+    case 2: ((int*) (buf + rec [1].adj)) [4] = rec [1].nt; break;
+    case 3: rec [1].ver = size; break;
+    }
+
+    spill (buf, size);
+    CHECK (damaged (1));
+    CHECK (!damaged (0) && !damaged (2));
+
+    free (buf);
+  }
+
+  for (i = 0; i < NMESH; i ++) free (mesh [i]);
+  remove (PATH);
+}
+
+int main (int argc, char **argv)
+{
+  RUN (roundtrip);
+  RUN (validation);
+
+  return DONE ();
+}
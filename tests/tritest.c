@@ -0,0 +1,281 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Tomasz Koziara
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * tritest.c: triangulation tests
+ */
+
+#include "tst.h"
+
+/* hull of 'n' points on the sphere (c, r) */
+static TRI* sphere (double *c, double r, int n, double **v, int *m)
+{
+  double d [3];
+  int i;
+
+  *v = malloc (sizeof (double [3]) * n);
+
+  for (i = 0; i < n; i ++)
+  {
+    tst_direction (d);
+    ADDMUL (c, r, d, &(*v) [3*i]);
+  }
+
+  return hull (*v, n, m);
+}
+
+/* merging a triangulation with its copy welds all vertex pairs, also for large coordinates,
+ * while vertices perturbed by more than epsilon stay apart and by less are welded */
+static void merge_weld (void)
+{
+  double c [3] = {0.0, 0.0, 0.0}, *v, *w, *x, s [] = {1.0, 1E8, 1E16};
+  int i, j, l, m, k, nv, nw;
+  TRI *one, *two, *out;
+
+  srand (8);
+
+  for (l = 0; l < 3; l ++)
+  {
+    SET (c, 3.0 * s [l]);
+    one = sphere (c, s [l], 5000, &v, &m);
+    two = TRI_Copy (one, m);
+    free (TRI_Vertices (one, m, &nv));
+
+    out = TRI_Merge (one, m, two, m, &k);
+    CHECK (k == 2*m);
+    free (TRI_Vertices (out, k, &nw));
+    CHECK (nw == nv);
+
+    free (out);
+    free (two);
+    free (one);
+    free (v);
+  }
+
+  SET (c, 0.0);
+  one = sphere (c, 1.0, 500, &v, &m);
+  two = TRI_Copy (one, m);
+  x = (double*) (two + m); /* copied vertices */
+  free (TRI_Vertices (one, m, &nv));
+  for (i = 0; i < nv; i ++)
+    for (j = 0; j < 3; j ++) x [3*i+j] += (i % 2 ? 0.1 : 3.0) * GEOMETRIC_EPSILON;
+
+  out = TRI_Merge (one, m, two, m, &k);
+  w = TRI_Vertices (out, k, &nw);
+  CHECK (nw == nv + (nv+1)/2);
+
+  free (w);
+  free (out);
+  free (two);
+  free (one);
+  free (v);
+}
+
+/* TRI_Copy, TRI_Vertices and TRI_Polarise order vertices by their first appearance */
+static void vertex_order (void)
+{
+  double c [3] = {0.0, 0.0, 0.0}, *v, *w, **first;
+  int i, j, k, m, nv, np, ok;
+  TRI *tri, *cp;
+  PFV *pfv;
+
+  srand (9);
+
+  tri = sphere (c, 1.0, 300, &v, &m);
+  first = malloc (sizeof (double*) * 3 * m);
+
+  for (i = nv = 0; i < m; i ++) /* first appearance order */
+  {
+    for (j = 0; j < 3; j ++)
+    {
+      for (k = 0; k < nv; k ++) if (first [k] == tri [i].ver [j]) break;
+      if (k == nv) first [nv ++] = tri [i].ver [j];
+    }
+  }
+
+  cp = TRI_Copy (tri, m);
+  w = (double*) (cp + m);
+  for (i = 0, ok = 1; i < m; i ++)
+    for (j = 0; j < 3; j ++)
+      ok = ok && first [(cp [i].ver [j] - w) / 3] == tri [i].ver [j];
+  CHECK (ok);
+
+  w = TRI_Vertices (tri, m, &k);
+  CHECK (k == nv);
+  for (i = 0, ok = 1; i < nv; i ++) ok = ok && memcmp (&w [3*i], first [i], sizeof (double [3])) == 0;
+  CHECK (ok);
+
+  pfv = TRI_Polarise (tri, m, &np);
+  CHECK (np == nv);
+  for (i = 0, ok = 1; i < np; i ++) ok = ok && pfv [i].nl == first [i];
+  CHECK (ok);
+
+  free (pfv);
+  free (w);
+  free (cp);
+  free (first);
+  free (tri);
+  free (v);
+}
+
+/* arena variants of the output routines equal the heap based ones */
+static void arena_variants (void)
+{
+  double c [3] = {0.0, 0.0, 0.0}, *v, *x, *y;
+  int i, j, m, l, k, nx, ny, ok;
+  TRI *tri, *a, *b, *aa, *bb;
+  PFV *pa, *pb;
+  ARENA arena;
+
+  srand (11);
+
+  ARENA_Init (&arena, 0);
+  tri = sphere (c, 1.0, 400, &v, &m);
+
+  a = hull_arena (v, 400, &l, &arena);
+  CHECK (l == m);
+  for (i = 0, ok = 1; i < m; i ++)
+    for (j = 0; j < 3; j ++) ok = ok && a [i].ver [j] == tri [i].ver [j];
+  CHECK (ok);
+
+  a = TRI_Copy_Arena (tri, m, &arena);
+  b = TRI_Copy (tri, m);
+  for (i = 0, ok = 1; i < m; i ++)
+    for (j = 0; j < 3; j ++) ok = ok && memcmp (a [i].ver [j], b [i].ver [j], sizeof (double [3])) == 0 &&
+				(a [i].adj [j] - a) == (b [i].adj [j] - b);
+  CHECK (ok);
+
+  aa = TRI_Merge_Arena (a, m, tri, m, &l, &arena);
+  bb = TRI_Merge (b, m, tri, m, &k);
+  CHECK (l == k && l == 2*m);
+  for (i = 0, ok = 1; i < l; i ++)
+    for (j = 0; j < 3; j ++) ok = ok && memcmp (aa [i].ver [j], bb [i].ver [j], sizeof (double [3])) == 0;
+  CHECK (ok);
+
+  x = TRI_Vertices_Arena (tri, m, &nx, &arena);
+  y = TRI_Vertices (tri, m, &ny);
+  CHECK (nx == ny && memcmp (x, y, sizeof (double [3]) * nx) == 0);
+  free (y);
+
+  x = TRI_Planes_Arena (tri, m, &nx, &arena);
+  y = TRI_Planes (tri, m, &ny);
+  CHECK (nx == ny && memcmp (x, y, sizeof (double [6]) * nx) == 0);
+  free (y);
+
+  pa = TRI_Polarise_Arena (tri, m, &nx, &arena);
+  pb = TRI_Polarise (tri, m, &ny);
+  CHECK (nx == ny);
+  for (i = 0, ok = 1; i < nx; i ++) ok = ok && pa [i].nl == pb [i].nl && pa [i].n - pa == pb [i].n - pb &&
+				    memcmp (pa [i].coord, pb [i].coord, sizeof (double [3])) == 0;
+  CHECK (ok);
+
+  free (pb);
+  free (bb);
+  free (b);
+  free (tri);
+  free (v);
+  ARENA_Release (&arena);
+}
+
+/* sort based adjacency of a closed hull and of its open part equals the hull adjacency,
+ * with the edges to the removed triangles left open */
+static void compadj (void)
+{
+  double c [3] = {0.0, 0.0, 0.0}, *v;
+  int i, j, k, m, *adj, ok;
+  TRI *tri;
+
+  srand (16);
+
+  tri = sphere (c, 1.0, 2000, &v, &m);
+  adj = malloc (sizeof (int [3]) * m);
+  for (i = 0; i < m; i ++)
+    for (j = 0; j < 3; j ++) adj [3*i+j] = tri [i].adj [j] - tri;
+
+  for (k = m; k > 0; k -= m/3) /* all, then two thirds and one third of the triangles */
+  {
+    TRI_Compadj (tri, k);
+    for (i = 0, ok = 1; i < k; i ++)
+      for (j = 0; j < 3; j ++) ok = ok && (adj [3*i+j] < k ? tri [i].adj [j] == tri + adj [3*i+j] : tri [i].adj [j] == NULL);
+    CHECK (ok);
+  }
+
+  free (adj);
+  free (tri);
+  free (v);
+}
+
+/* mass properties of a rotated box hull against the closed form, and of its indexed mesh */
+static void mass (void)
+{
+  double c [3] = {0.5, -1.0, 2.0}, h [3] = {1.0, 2.0, 3.0}, o [3] = {0.3, -0.2, 0.7};
+  double R [9], v [24], x [3], y [3], e [9], f [9], ref [9], vol;
+  int i, j, k, m;
+  TRIMESH *mesh;
+  TRI *tri;
+
+  EXPMAP (o, R);
+
+  for (i = 0; i < 8; i ++)
+  {
+    x [0] = i & 1 ? h [0] : -h [0];
+    x [1] = i & 2 ? h [1] : -h [1];
+    x [2] = i & 4 ? h [2] : -h [2];
+    NVADDMUL (c, R, x, v + 3*i);
+  }
+
+  tri = hull (v, 8, &m);
+  vol = 8.0 * h [0] * h [1] * h [2];
+
+  for (i = 0; i < 3; i ++) /* euler = R diag (vol h^2 / 3) R' */
+    for (j = 0; j < 3; j ++)
+      for (k = 0, ref [3*j+i] = 0.0; k < 3; k ++) ref [3*j+i] += R [3*k+i] * R [3*k+j] * vol * h [k] * h [k] / 3.0;
+
+  CHECK_CLOSE (TRI_Mass (tri, m, x, e), vol, 1E-12);
+  for (i = 0; i < 3; i ++) CHECK_CLOSE (x [i], c [i], 1E-12);
+  for (i = 0; i < 9; i ++) CHECK_CLOSE (e [i], ref [i], 1E-12);
+
+  CHECK_CLOSE (TRI_Char (tri, m, y), vol, 1E-12);
+  for (i = 0; i < 3; i ++) CHECK_CLOSE (y [i], c [i], 1E-12);
+
+  mesh = TRI_Tomesh (tri, m, v, 8);
+  CHECK_CLOSE (TRI_Meshmass (mesh, y, f), vol, 1E-12);
+  for (i = 0; i < 3; i ++) CHECK_CLOSE (y [i], c [i], 1E-12);
+  for (i = 0; i < 9; i ++) CHECK_CLOSE (f [i], ref [i], 1E-12);
+  CHECK (TRI_Mass (tri, m, NULL, NULL) == TRI_Mass (tri, m, x, e));
+
+  free (mesh);
+  free (tri);
+}
+
+int main (int argc, char **argv)
+{
+  RUN (merge_weld);
+  RUN (vertex_order);
+  RUN (arena_variants);
+  RUN (compadj);
+  RUN (mass);
+
+  return DONE ();
+}
@@ -0,0 +1,117 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Tomasz Koziara
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * tst.h: minimal test harness
+ */
+
+#ifndef __tst__
+#define __tst__
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "alg.h"
+#include "tri.h"
+#include "hul.h"
+
+static int tst_checks = 0, tst_failed = 0;
+
+/* count a check and report its failure */
+#define CHECK(test)\
+do {\
+  tst_checks ++;\
+  if (!(test))\
+  {\
+    fprintf (stderr, "%s:%d: CHECK (%s) failed\n", __FILE__, __LINE__, #test);\
+    tst_failed ++;\
+  }\
+} while (0)
+
+/* check that 'a' and 'b' agree up to the relative tolerance 'tol' */
+#define CHECK_CLOSE(a, b, tol) CHECK (fabs ((a) - (b)) <= (tol) * (1.0 + fabs (a) + fabs (b)))
+
+/* run a test function */
+#define RUN(test)\
+do {\
+  int failed = tst_failed;\
+  test ();\
+  printf ("%-40s %s\n", #test, failed == tst_failed ? "ok" : "FAILED");\
+} while (0)
+
+/* summary and exit code */
+#define DONE() (printf ("%d checks, %d failed\n", tst_checks, tst_failed), tst_failed ? 1 : 0)
+
+/* random unit vector */
+inline static void tst_direction (double *d)
+{
+  double l;
+
+  do
+  {
+    d [0] = DRANDEXT (-1.0, 1.0);
+    d [1] = DRANDEXT (-1.0, 1.0);
+    d [2] = DRANDEXT (-1.0, 1.0);
+    l = DOT (d, d);
+  } while (l > 1.0 || l < 1E-6);
+
+  l = sqrt (l);
+  DIV (d, l, d);
+}
+
+/* random convex polytope: the hull of 'n' points on the sphere (c, r);
+ * output its vertices (v, nv) and unit normal planes (p, np), as cvi input */
+inline static void tst_polytope (double *c, double r, int n, double **v, int *nv, double **p, int *np)
+{
+  double *q, d [3];
+  int i, m;
+  TRI *tri;
+
+  q = malloc (sizeof (double [3]) * n);
+
+  for (i = 0; i < n; i ++)
+  {
+    tst_direction (d);
+    ADDMUL (c, r, d, &q [3*i]);
+  }
+
+  tri = hull (q, n, &m);
+  for (i = 0; i < m; i ++) NORMALIZE (tri [i].out);
+  *v = TRI_Vertices (tri, m, nv);
+  *p = TRI_Planes (tri, m, np);
+
+  free (tri);
+  free (q);
+}
+
+/* volume of a closed triangle surface */
+inline static double tst_volume (TRI *tri, int m)
+{
+  double c [3];
+
+  return tri && m ? TRI_Char (tri, m, c) : 0.0;
+}
+
+#endif
@@ -0,0 +1,269 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Tomasz Koziara
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * tmc.c: memory mapped triangle mesh cache
+ */
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <limits.h>
+#include <float.h>
+#include <stdlib.h>
+#include <string.h>
+#include "tmc.h"
+#include "alg.h"
+#include "err.h"
+
+#define MAGIC "CVXTMC" /* file magic */
+#define ENDIAN 0x01020304 /* byte order tag */
+#define ALIGN 64 /* array alignment within the file */
+
+/* file header */
+struct tmc_header
+{
+  char magic [8];
+  uint32_t version;
+  uint32_t endian;
+  uint64_t size; /* file size */
+  int64_t count; /* number of records following the header */
+};
+
+/* round up to the alignment */
+inline static int64_t align (int64_t x)
+{
+  return (x + ALIGN - 1) / ALIGN * ALIGN;
+}
+
+/* write 'size' bytes and pad the file up to the alignment */
+static void put (FILE *f, void *data, size_t size)
+{
+  static char zero [ALIGN];
+  long pos;
+  size_t pad;
+
+  ASSERT (fwrite (data, 1, size, f) == size, ERR_FILE_WRITE);
+  ASSERT ((pos = ftell (f)) >= 0, ERR_FILE_WRITE);
+  pad = align (pos) - pos;
+  if (pad) ASSERT (fwrite (zero, 1, pad, f) == pad, ERR_FILE_WRITE);
+}
+
+/* write indexed meshes into a cache file */
+void TMC_Write (TRIMESH **mesh, int count, char *path)
+{
+  struct tmc_header head;
+  double *pla, *p, *q;
+  int64_t off;
+  TMCREC *rec, *r;
+  TRIMESH *m;
+  FILE *f;
+  int i, j;
+
+  ERRMEM (rec = calloc (count, sizeof (TMCREC)));
+
+  off = align (sizeof (struct tmc_header) + sizeof (TMCREC) * count);
+
+  for (i = 0; i < count; i ++) /* layout and derived data */
+  {
+    m = mesh [i];
+    r = &rec [i];
+    r->nv = m->nv;
+    r->nt = m->nt;
+    r->ver = off; off += align (sizeof (double [3]) * m->nv);
+    r->nl = off; off += align (sizeof (double [3]) * m->nt);
+    r->pla = off; off += align (sizeof (double [6]) * m->nt);
+    r->tri = off; off += align (sizeof (int [3]) * m->nt);
+    r->adj = off; off += align (sizeof (int [3]) * m->nt);
+    r->flg = off; off += align (sizeof (int) * m->nt);
+
+    r->extents [0] = r->extents [1] = r->extents [2] = DBL_MAX;
+    r->extents [3] = r->extents [4] = r->extents [5] = -DBL_MAX;
+    for (j = 0, p = m->ver; j < m->nv; j ++, p += 3)
+    {
+      if (p [0] < r->extents [0]) r->extents [0] = p [0];
+      if (p [1] < r->extents [1]) r->extents [1] = p [1];
+      if (p [2] < r->extents [2]) r->extents [2] = p [2];
+      if (p [0] > r->extents [3]) r->extents [3] = p [0];
+      if (p [1] > r->extents [4]) r->extents [4] = p [1];
+      if (p [2] > r->extents [5]) r->extents [5] = p [2];
+    }
+
+    r->volume = TRI_Meshmass (m, r->center, r->euler);
+  }
+
+  memset (&head, 0, sizeof (head));
+  strcpy (head.magic, MAGIC);
+  head.version = TMC_VERSION;
+  head.endian = ENDIAN;
+  head.size = off;
+  head.count = count;
+
+  ASSERT (f = fopen (path, "wb"), ERR_FILE_OPEN);
+  ASSERT (fwrite (&head, sizeof (head), 1, f) == 1, ERR_FILE_WRITE);
+  put (f, rec, sizeof (TMCREC) * count);
+
+  for (i = 0; i < count; i ++)
+  {
+    m = mesh [i];
+    put (f, m->ver, sizeof (double [3]) * m->nv);
+    put (f, m->nl, sizeof (double [3]) * m->nt);
+
+    ERRMEM (pla = malloc (sizeof (double [6]) * m->nt));
+    for (j = 0, p = pla; j < m->nt; j ++, p += 6)
+    {
+      q = &m->nl [3*j];
+      COPY (q, p);
+      q = &m->ver [3 * m->tri [3*j]];
+      COPY (q, p+3);
+    }
+    put (f, pla, sizeof (double [6]) * m->nt);
+    free (pla);
+
+    put (f, m->tri, sizeof (int [3]) * m->nt);
+    put (f, m->adj, sizeof (int [3]) * m->nt);
+    put (f, m->flg, sizeof (int) * m->nt);
+  }
+
+  ASSERT (fclose (f) == 0, ERR_FILE_CLOSE);
+
+  free (rec);
+}
+
+/* map a cache file */
+TMC* TMC_Map (char *path)
+{
+  struct tmc_header *head;
+  struct stat st;
+  void *addr;
+  TMC *tmc;
+  int fd;
+
+  ASSERT ((fd = open (path, O_RDONLY)) >= 0, ERR_FILE_OPEN);
+
+  if (fstat (fd, &st) < 0) { close (fd); THROW (ERR_FILE_READ); }
+
+  if ((size_t) st.st_size < sizeof (struct tmc_header)) { close (fd); THROW (ERR_FILE_FORMAT); }
+
+  addr = mmap (NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  close (fd);
+  ASSERT (addr != MAP_FAILED, ERR_FILE_READ);
+
+  head = addr;
+
+  if (strncmp (head->magic, MAGIC, 8) || head->version != TMC_VERSION || head->endian != ENDIAN ||
+      head->size != (uint64_t) st.st_size || head->count < 0 || head->count > INT_MAX ||
+      (uint64_t) head->count > (head->size - sizeof (struct tmc_header)) / sizeof (TMCREC))
+  {
+    munmap (addr, st.st_size);
+    THROW (ERR_FILE_FORMAT);
+  }
+
+  ERRMEM (tmc = calloc (1, sizeof (TMC) + (sizeof (TRIMESH) + sizeof (TRI*)) * head->count));
+  tmc->mesh = (TRIMESH*) (tmc + 1);
+  tmc->tri = (TRI**) (tmc->mesh + head->count);
+  tmc->rec = (TMCREC*) (head + 1);
+  tmc->count = head->count;
+  tmc->addr = addr;
+  tmc->size = st.st_size;
+
+  return tmc;
+}
+
+/* test whether an array of 'bytes' at offset 'off' lies within the mapping of 'size' bytes */
+inline static int inside (int64_t off, size_t bytes, size_t size)
+{
+  return off >= 0 && off % sizeof (double) == 0 && (uint64_t) off <= size && bytes <= size - (size_t) off;
+}
+
+/* return the mesh view of a record */
+TRIMESH* TMC_Mesh (TMC *tmc, int i)
+{
+  TRIMESH *mesh = &tmc->mesh [i];
+  TMCREC *r = &tmc->rec [i];
+  char *base = tmc->addr;
+  int j, *tri, *adj;
+
+  ASSERT_DEBUG (i >= 0 && i < tmc->count, "Record index out of bounds");
+
+  if (mesh->ver == NULL) /* pointer fix-up and validation on first access */
+  {
+    ASSERT (r->nv >= 0 && r->nt >= 0 &&
+	    inside (r->ver, sizeof (double [3]) * r->nv, tmc->size) &&
+	    inside (r->nl, sizeof (double [3]) * r->nt, tmc->size) &&
+	    inside (r->pla, sizeof (double [6]) * r->nt, tmc->size) &&
+	    inside (r->tri, sizeof (int [3]) * r->nt, tmc->size) &&
+	    inside (r->adj, sizeof (int [3]) * r->nt, tmc->size) &&
+	    inside (r->flg, sizeof (int) * r->nt, tmc->size), ERR_FILE_FORMAT);
+
+    tri = (int*) (base + r->tri);
+    adj = (int*) (base + r->adj);
+
+    for (j = 0; j < 3 * r->nt; j ++) /* vertex and neighbour indices */
+    {
+      ASSERT (tri [j] >= 0 && tri [j] < r->nv && adj [j] >= -1 && adj [j] < r->nt, ERR_FILE_FORMAT);
+    }
+
+    mesh->nl = (double*) (base + r->nl);
+    mesh->tri = tri;
+    mesh->adj = adj;
+    mesh->flg = (int*) (base + r->flg);
+    mesh->nv = r->nv;
+    mesh->nt = r->nt;
+    mesh->ver = (double*) (base + r->ver);
+  }
+
+  return mesh;
+}
+
+/* return the planes of a record */
+double* TMC_Planes (TMC *tmc, int i)
+{
+  TMC_Mesh (tmc, i); /* validates the record */
+
+  return (double*) ((char*) tmc->addr + tmc->rec [i].pla);
+}
+
+/* return the triangles of a record */
+TRI* TMC_Tri (TMC *tmc, int i)
+{
+  if (tmc->tri [i] == NULL) tmc->tri [i] = TRI_Frommesh (TMC_Mesh (tmc, i));
+
+  return tmc->tri [i];
+}
+
+/* unmap the cache file */
+void TMC_Unmap (TMC *tmc)
+{
+  int i;
+
+  for (i = 0; i < tmc->count; i ++) free (tmc->tri [i]);
+
+  munmap (tmc->addr, tmc->size);
+
+  free (tmc);
+}
@@ -0,0 +1,87 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Tomasz Koziara
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * tmc.h: memory mapped triangle mesh cache
+ */
+
+#include <stdint.h>
+#include "tri.h"
+
+#ifndef __tmc__
+#define __tmc__
+
+#define TMC_VERSION 1 /* cache file format version */
+
+typedef struct tmc_record TMCREC; /* mesh record, as stored in the file */
+struct tmc_record
+{
+  double extents [6]; /* min x, y, z, max x, y, z */
+  double volume; /* enclosed volume */
+  double center [3]; /* mass center */
+  double euler [9]; /* Euler tensor, as in TRI_Mass */
+  int64_t ver, nl, pla, tri, adj, flg; /* array offsets from the start of the file */
+  int32_t nv, nt; /* numbers of vertices and triangles */
+};
+
+typedef struct tmc TMC; /* mapped cache file */
+struct tmc
+{
+  TMCREC *rec; /* 'count' records within the mapping */
+  TRIMESH *mesh; /* mesh views of the records, set up on first access */
+  TRI **tri; /* triangles of the records, created on first access */
+  int count;
+  void *addr; /* mapping address */
+  size_t size; /* mapping size */
+};
+
+/* write 'count' indexed meshes with valid adjacency (e.g. from TRI_Tomesh) into a cache file,
+ * together with their planes, extents and mass properties; data is stored in the native
+ * byte order, which is checked when mapping; file errors throw ERR_FILE_OPEN or ERR_FILE_WRITE */
+void TMC_Write (TRIMESH **mesh, int count, char *path);
+
+/* map a cache file; only the file header is validated and nothing is copied,
+ * hence the cost of mapping does not depend on the size of the meshes (records
+ * are validated lazily by TMC_Mesh); a foreign or damaged file throws ERR_FILE_FORMAT;
+ * POSIX mmap is used and the mapping is private, so modifying the mapped arrays
+ * (e.g. flags) does not alter the file */
+TMC* TMC_Map (char *path);
+
+/* return the mesh view of record 'i', whose arrays point into the mapping; the array
+ * bounds and the vertex and neighbour indices are validated on first access, which
+ * reads all 6 nt indices of the record once (so that the first access, unlike the later
+ * ones, costs O(nt) and pages in the index arrays); a damaged record throws ERR_FILE_FORMAT */
+TRIMESH* TMC_Mesh (TMC *tmc, int i);
+
+/* return the planes of record 'i' as (normal, point) of size (double [6]) x nt, as in TRI_Planes */
+double* TMC_Planes (TMC *tmc, int i);
+
+/* return the triangles of record 'i' in the format of TRI_Frommesh;
+ * they are created on first access and freed by TMC_Unmap */
+TRI* TMC_Tri (TMC *tmc, int i);
+
+/* unmap the cache file */
+void TMC_Unmap (TMC *tmc);
+
+#endif
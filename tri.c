@@ -27,6 +27,10 @@
  */
 
 #include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
+#include <math.h>
 #include "tri.h"
 #include "mem.h"
 #include "map.h"
@@ -81,6 +85,55 @@ static void markadj (TRI *t, int flg)
   }
 }
 
+/* hash of a pointer */
+inline static int ptrhash (double *p, int mask)
+{
+  return (int) ((((uint64_t) (size_t) p >> 3) * 0x9E3779B97F4A7C15ull) >> 32) & mask;
+}
+
+/* index unique vertices of (tri, n) in the order of their first appearance, using an open
+ * addressing pointer hash; 'ver' receives unique vertex pointers, 'first' (if not NULL) the
+ * first triangle using each of them and 'corner' (if not NULL) the vertex indices of the
+ * triangle corners; all three tables are of size 3n; return the number of unique vertices */
+static int vertex_index (TRI *tri, int n, double **ver, TRI **first, int *corner, ARENA *arena)
+{
+  int i, j, k, size, mask, *val;
+  double **key, *p;
+  TRI *t;
+
+  for (size = 16; size < 6*n; size *= 2);
+  mask = size - 1;
+
+  ERRMEM (key = ARENA_Alloc (arena, (sizeof (double*) + sizeof (int)) * size));
+  val = (int*) (key + size);
+  memset (key, 0, sizeof (double*) * size);
+
+  for (t = tri, k = 0; t < tri + n; t ++)
+  {
+    for (i = 0; i < 3; i ++)
+    {
+      p = t->ver [i];
+
+      for (j = ptrhash (p, mask); key [j] && key [j] != p; j = (j + 1) & mask);
+
+      if (!key [j]) /* new vertex */
+      {
+	key [j] = p;
+	val [j] = k;
+	ver [k] = p;
+	if (first) first [k] = t;
+	k ++;
+      }
+
+      if (corner) corner [3*(t-tri)+i] = val [j];
+    }
+  }
+
+  if (!arena) free (key);
+
+  return k;
+}
+
 /* sort adjacency */
 void TRI_Sortadj (TRI *tri)
 {
@@ -125,50 +178,43 @@ int TRI_Addadj (TRI *p, TRI *q)
 /* compy into a compact memory block */
 TRI* TRI_Copy (TRI *tri, int n)
 {
-  int vcnt; /* number of vertices */
-  MAP *vm, *im; /* map of visited vertices; iterator 'im' */
-  MEM mem; /* memory for map items */
+  return TRI_Copy_Arena (tri, n, NULL);
+}
+
+/* copy into a compact arena memory block */
+TRI* TRI_Copy_Arena (TRI *tri, int n, ARENA *arena)
+{
+  int vcnt, *corner; /* number of vertices and vertex indices of corners */
+  double *v, **ver;
   TRI *t, *s, *e, *o; /* triangle iterators 't' and 's', table end 'e' and output 'o' */
-  double *v;
   int i;
 
-  MEM_Init (&mem, sizeof (MAP), n * 3);
+  ERRMEM (ver = ARENA_Alloc (arena, (sizeof (double*) + sizeof (int)) * 3 * n));
+  corner = (int*) (ver + 3*n);
+  vcnt = vertex_index (tri, n, ver, NULL, corner, arena);
   e = tri + n;
-  vm = NULL;
-  vcnt = 0;
-
-  for (t = tri; t < e; t ++) /* for each triangle */
-  {
-    for (i = 0; i < 3; i ++) /* for each vertex */
-    {
-      if (! MAP_Find_Node (vm, t->ver [i], NULL)) /* if the vertex was not mapped before */
-      {
-	vcnt ++; /* make account of it */
-	MAP_Insert (&mem, &vm, t->ver [i], NULL, NULL); /* map vertex 'v' */
-      }
-    }
-  }
 
   /* alloc output memory */
-  ERRMEM (o = malloc (sizeof (TRI)*n + sizeof (double [3]) * vcnt));
+  ERRMEM (o = ARENA_Alloc (arena, sizeof (TRI)*n + sizeof (double [3]) * vcnt));
   v = (double*)(o + n);
 
-  /* map old vertices into new placeholders */
-  for (i = 0, im = MAP_First (vm); im; im = MAP_Next (im), i ++) im->data = (v + i*3);
+  /* copy vertices into new placeholders */
+  for (i = 0; i < vcnt; i ++) { COPY (ver [i], v + i*3); }
 
-  for (t = tri, s = o; t < e; t ++, s ++) /* again => for each triangle */
+  for (t = tri, s = o; t < e; t ++, s ++) /* for each triangle */
   {
     COPY (t->out, s->out);
     s->flg = t->flg;
+    s->ptr = t->ptr;
     
     for (i = 0; i < 3; i ++)
     {
-      if (t->adj [i]) s->adj [i] = o + (t->adj[i] - tri); /* map adjacency */
-      s->ver [i] = MAP_Find (vm, t->ver [i], NULL); /* map new vertex */
+      s->adj [i] = t->adj [i] ? o + (t->adj[i] - tri) : NULL; /* map adjacency */
+      s->ver [i] = v + 3 * corner [3*(t-tri)+i]; /* map new vertex */
     }
   }
 
-  MEM_Release (&mem);
+  if (!arena) free (ver);
 
   return o;
 }
@@ -176,96 +222,195 @@ TRI* TRI_Copy (TRI *tri, int n)
 /* merge two triangulations; adjacency is not maintained */
 TRI* TRI_Merge (TRI *one, int none, TRI *two, int ntwo, int *m)
 {
-  TRI *out, *t, *e, *q;
-  KDT *kdtree, *kd;
-  SET *ver, *item;
-  double *v, *w;
-  MEM setmem;
-  int i, j;
+  return TRI_Merge_Arena (one, none, two, ntwo, m, NULL);
+}
 
-  MEM_Init (&setmem, sizeof (SET), 3*(none+ntwo));
-  ver = NULL;
+/* welding grid cells are at least epsilon sized and at least this fraction of the
+ * coordinates scale, so that the cell coordinates of large inputs remain distinct */
+#define WELD_CELL 1E-12
 
-  for (t = one, e = t + none; t != e; t ++)
-  {
-    for (i = 0; i < 3; i ++) SET_Insert (&setmem, &ver, t->ver [i], NULL);
-  }
+/* welding grid => an open addressing hash table of cells */
+typedef struct
+{
+  int64_t *key; /* cell coordinates (3 per slot) */
+  int *head; /* first vertex in a cell or -1 for an empty slot */
+  double **ptr; /* welded input vertex pointers */
+  int *pid; /* their output vertex indices */
+  double **rep; /* representative vertices */
+  int *next; /* next representative in a cell */
+  int mask, nrep;
+  double h; /* cell size */
+} WELD;
+
+/* hash of a cell */
+inline static int cellhash (int64_t *c, int mask)
+{
+  uint64_t h = (uint64_t) c [0] * 0x9E3779B97F4A7C15ull ^ (uint64_t) c [1] * 0xC2B2AE3D27D4EB4Full ^ (uint64_t) c [2] * 0x165667B19E3779F9ull;
+  return (int) ((h ^ (h >> 29)) >> 16) & mask;
+}
 
-  for (t = two, e = t + ntwo; t != e; t ++)
+/* cell coordinate of 'x' */
+inline static int64_t cellcoord (double x, double h)
+{
+  x = floor (x / h);
+  return x < -4E18 ? (int64_t) -4E18 : x > 4E18 ? (int64_t) 4E18 : (int64_t) x; /* far cells (non-finite input) are merged */
+}
+
+/* return slot of cell 'c' (empty if it was not found) */
+static int cellslot (WELD *w, int64_t *c)
+{
+  int s;
+
+  for (s = cellhash (c, w->mask); w->head [s] >= 0; s = (s + 1) & w->mask)
   {
-    for (i = 0; i < 3; i ++) SET_Insert (&setmem, &ver, t->ver [i], NULL);
+    if (w->key [3*s] == c [0] && w->key [3*s+1] == c [1] && w->key [3*s+2] == c [2]) break;
   }
 
-  i = SET_Size (ver);
-  ERRMEM (v = malloc (i * sizeof (double [3])));
-  for (item = SET_First (ver), w = v; item; item = SET_Next (item), w += 3)
+  return s;
+}
+
+/* return output index of vertex 'p' snapped to the nearest representative within
+ * epsilon, searching the cells overlapped by the epsilon box of 'p'; if there is
+ * no such representative, 'p' becomes a new one */
+static int weld (WELD *w, double *p)
+{
+  int64_t lo [3], hi [3], c [3];
+  double d [3], r, rmin;
+  int s, i, best;
+
+  for (s = ptrhash (p, w->mask); w->ptr [s]; s = (s + 1) & w->mask)
   {
-    double *p = item->data;
-    COPY (p, w);
+    if (w->ptr [s] == p) return w->pid [s]; /* welded before */
   }
-  kdtree = KDT_Create (i, v, GEOMETRIC_EPSILON);
-  free (v);
-  i = KDT_Size (kdtree);
-  ERRMEM (out = MEM_CALLOC (i * sizeof (double [3]) + (none+ntwo) * sizeof (TRI)));
-  v = (double*) (out + none + ntwo);
+  w->ptr [s] = p;
 
-  /* copy vertices */
-  for (kd = KDT_First (kdtree); kd; kd = KDT_Next (kd))
+  for (i = 0; i < 3; i ++)
   {
-    double *p = kd->p;
-    w = &v [3*kd->n];
-    COPY (p, w);
+    lo [i] = cellcoord (p [i] - GEOMETRIC_EPSILON, w->h);
+    hi [i] = cellcoord (p [i] + GEOMETRIC_EPSILON, w->h);
   }
 
-  /* copy triangles */
-  for (t = one, e = t + none, q = out; t != e; t ++)
+  rmin = GEOMETRIC_EPSILON * GEOMETRIC_EPSILON;
+  best = -1;
+
+  for (c [0] = lo [0]; c [0] <= hi [0]; c [0] ++)
+  for (c [1] = lo [1]; c [1] <= hi [1]; c [1] ++)
+  for (c [2] = lo [2]; c [2] <= hi [2]; c [2] ++)
   {
-    for (i = 0; i < 3; i ++)
+    for (i = w->head [cellslot (w, c)]; i >= 0; i = w->next [i])
     {
-      kd = KDT_Nearest (kdtree, t->ver [i], GEOMETRIC_EPSILON);
-      ASSERT_DEBUG (kd, "Kd-tree point query failed");
-      q->ver [i] = &v [3*kd->n];
-      for (j = 0; j < i; j ++)
-	if (q->ver [j] == q->ver [i]) break;
-      if (j < i) break;  /* degenerate */
-    }
-    if (i == 3)
-    {
-      COPY (t->out, q->out);
-      q->flg = t->flg;
-      q ++;
+      SUB (p, w->rep [i], d);
+      r = DOT (d, d);
+      if (r < rmin) { rmin = r; best = i; }
     }
   }
 
+  if (best < 0) /* new representative */
+  {
+    best = w->nrep ++;
+    w->rep [best] = p;
+    c [0] = cellcoord (p [0], w->h);
+    c [1] = cellcoord (p [1], w->h);
+    c [2] = cellcoord (p [2], w->h);
+    i = cellslot (w, c);
+    w->key [3*i] = c [0];
+    w->key [3*i+1] = c [1];
+    w->key [3*i+2] = c [2];
+    w->next [best] = w->head [i];
+    w->head [i] = best;
+  }
+
+  w->pid [s] = best;
+
+  return best;
+}
+
+/* merge two triangulations into arena memory */
+TRI* TRI_Merge_Arena (TRI *one, int none, TRI *two, int ntwo, int *m, ARENA *arena)
+{
+  TRI *out, *t, *e, *q;
+  int i, j, n, size, *idx;
+  double *v, *w, r;
+  WELD wd;
+
+  /* weld the vertices of both triangulations, in order */
+  n = 3 * (none + ntwo);
+  for (size = 16; size < 2*n; size *= 2);
+  ERRMEM (wd.key = ARENA_Alloc (arena, sizeof (int64_t [3]) * size + sizeof (double*) * (size + 2*n) + sizeof (int) * (2*size + 2*n)));
+  wd.ptr = (double**) (wd.key + 3*size);
+  wd.rep = wd.ptr + size;
+  wd.head = (int*) (wd.rep + n);
+  wd.pid = wd.head + size;
+  wd.next = wd.pid + size;
+  idx = wd.next + n;
+  wd.mask = size - 1;
+  wd.nrep = 0;
+  for (i = 0; i < size; i ++) { wd.head [i] = -1; wd.ptr [i] = NULL; }
+
+  /* cell size scaled by the coordinates magnitude => at most 1 / WELD_CELL cells
+   * per dimension, hence no clamping of cell coordinates and no crowded cells */
+  for (t = one, e = t + none, wd.h = 0.0; t != e; t ++)
+  {
+    for (i = 0; i < 3; i ++) { MAXABS (t->ver [i], r); wd.h = MAX (wd.h, r); }
+  }
+  for (t = two, e = t + ntwo; t != e; t ++)
+  {
+    for (i = 0; i < 3; i ++) { MAXABS (t->ver [i], r); wd.h = MAX (wd.h, r); }
+  }
+  wd.h = MAX (GEOMETRIC_EPSILON, wd.h * WELD_CELL);
+
+  for (t = one, e = t + none, j = 0; t != e; t ++)
+  {
+    for (i = 0; i < 3; i ++) idx [j ++] = weld (&wd, t->ver [i]);
+  }
+
   for (t = two, e = t + ntwo; t != e; t ++)
   {
-    for (i = 0; i < 3; i ++)
-    {
-      kd = KDT_Nearest (kdtree, t->ver [i], GEOMETRIC_EPSILON);
-      ASSERT_DEBUG (kd, "Kd-tree point query failed");
-      q->ver [i] = &v [3*kd->n];
-      for (j = 0; j < i; j ++)
-	if (q->ver [j] == q->ver [i]) break;
-      if (j < i) break;  /* degenerate */
-    }
-    if (i == 3)
-    {
-      COPY (t->out, q->out);
-      q->flg = t->flg;
-      q ++;
-    }
+    for (i = 0; i < 3; i ++) idx [j ++] = weld (&wd, t->ver [i]);
+  }
+
+  ERRMEM (out = ARENA_Alloc (arena, wd.nrep * sizeof (double [3]) + (none+ntwo) * sizeof (TRI)));
+  memset (out, 0, (none+ntwo) * sizeof (TRI));
+  v = (double*) (out + none + ntwo);
+
+  /* copy vertices */
+  for (i = 0, w = v; i < wd.nrep; i ++, w += 3)
+  {
+    COPY (wd.rep [i], w);
+  }
+
+  /* copy nondegenerate triangles */
+  for (j = 0, q = out; j < none + ntwo; j ++)
+  {
+    t = j < none ? one + j : two + (j - none);
+
+    if (idx [3*j] == idx [3*j+1] || idx [3*j+1] == idx [3*j+2] || idx [3*j+2] == idx [3*j]) continue; /* degenerate */
+
+    for (i = 0; i < 3; i ++) q->ver [i] = &v [3*idx[3*j+i]];
+    COPY (t->out, q->out);
+    q->flg = t->flg;
+    q ++;
   }
 
   *m = q - out; /* nondegenerate triangles count */
 
-  MEM_Release (&setmem);
-  KDT_Destroy (kdtree);
+  if (!arena) free (wd.key);
 
   return out;
 }
 
-/* compute adjacency structure */
-void TRI_Compadj (TRI *tri, int n)
+/* edge record => sorted by the key of its vertex pair */
+struct edgerec
+{
+  uint64_t key; /* (first vertex offset << 32) | second vertex offset */
+  int edge; /* 3 x triangle index + local edge index */
+};
+
+/* number of bits in a radix sort digit */
+#define RADIX_BITS 11
+
+/* compute adjacency structure by mapping edges */
+static void compadj_map (TRI *tri, int n)
 {
   MAP *vm; /* map of vertex pairs */
   TRI *t, *s, *e;
@@ -304,6 +449,96 @@ void TRI_Compadj (TRI *tri, int n)
   MEM_Release (&mp);
 }
 
+/* compute adjacency structure by sorting edge records */
+void TRI_Compadj (TRI *tri, int n)
+{
+  struct edgerec *rec, *tmp, *swp;
+  double *lo, *hi, *a, *b;
+  int i, j, k, l, bits, shift, *cnt;
+  uint64_t span, key;
+  TRI *t, *s;
+
+  if (n <= 0) return;
+
+  /* vertex pointers are offsets from the lowest vertex; for
+   * offsets wider than 32 bits fall back on the edge map */
+  for (lo = hi = tri->ver [0], t = tri; t < tri + n; t ++)
+  {
+    for (i = 0; i < 3; i ++)
+    {
+      if (t->ver [i] < lo) lo = t->ver [i];
+      if (t->ver [i] > hi) hi = t->ver [i];
+    }
+  }
+  span = ((size_t) hi - (size_t) lo) / sizeof (double);
+  if (span >> 32 || 3 * (long) n > INT_MAX) { compadj_map (tri, n); return; }
+  for (bits = 1; span >> bits; bits ++);
+
+  ERRMEM (rec = malloc (sizeof (struct edgerec) * 6 * n + sizeof (int) * (1 << RADIX_BITS)));
+  tmp = rec + 3*n;
+  cnt = (int*) (tmp + 3*n);
+
+#if OPENMP
+  #pragma omp parallel for private (i, t, a, b)
+#endif
+  for (j = 0; j < n; j ++) /* emit edge records */
+  {
+    t = tri + j;
+    for (i = 0; i < 3; i ++)
+    {
+      a = t->ver [i];
+      b = t->ver [i < 2 ? i+1 : 0];
+      if (a > b) { double *c = a; a = b; b = c; }
+      rec [3*j+i].key = ((uint64_t) (((size_t) a - (size_t) lo) / sizeof (double)) << 32) |
+                         (uint64_t) (((size_t) b - (size_t) lo) / sizeof (double));
+      rec [3*j+i].edge = 3*j + i;
+      t->adj [i] = NULL;
+    }
+  }
+
+  /* LSD radix sort of the significant bits of both halves of the keys;
+   * it is stable, hence equal keys remain ordered by triangles */
+  for (shift = 0; shift < 32 + bits; shift += RADIX_BITS)
+  {
+    if (shift < 32 && shift >= bits) shift = 32; /* skip zero bits of the second offsets */
+
+    memset (cnt, 0, sizeof (int) * (1 << RADIX_BITS));
+    for (j = 0; j < 3*n; j ++) cnt [(rec [j].key >> shift) & ((1 << RADIX_BITS) - 1)] ++;
+    for (j = k = 0; j < (1 << RADIX_BITS); j ++) { l = cnt [j]; cnt [j] = k; k += l; }
+    for (j = 0; j < 3*n; j ++) tmp [cnt [(rec [j].key >> shift) & ((1 << RADIX_BITS) - 1)] ++] = rec [j];
+    swp = rec; rec = tmp; tmp = swp;
+  }
+
+  /* pair neighbours within the runs of equal keys */
+#if OPENMP
+  #pragma omp parallel for private (key, k, t, s, i, l)
+#endif
+  for (j = 0; j < 3*n; j ++)
+  {
+    key = rec [j].key;
+    if (j > 0 && rec [j-1].key == key) continue; /* not the first in a run */
+    if (j + 1 == 3*n || rec [j+1].key != key) continue; /* boundary edge */
+
+    t = tri + rec [j].edge / 3;
+    i = rec [j].edge % 3;
+    s = tri + rec [j+1].edge / 3;
+    l = rec [j+1].edge % 3;
+    t->adj [i] = s;
+    s->adj [l] = t;
+  }
+
+  for (j = 0; j < 3*n; j ++) /* more than two triangles sharing an edge */
+  {
+    if (j > 1 && rec [j-2].key == rec [j].key)
+    {
+      for (k = j - 2; k > 0 && rec [k-1].key == rec [j].key; k --); /* first in the run */
+      ASSERT_TEXT (TRI_Addadj (tri + rec [k].edge / 3, tri + rec [j].edge / 3), "Too many adjacent triangles");
+    }
+  }
+
+  free (rec < tmp ? rec : tmp);
+}
+
 /* intput a triangulation and a point; output the same triangulation
  * but reordered so that the first 'm' triangles are topologically
  * adjacent to the point; no memory is allocated in this process;
@@ -357,44 +592,44 @@ TRI* TRI_Topoadj (TRI *tri, int n, double *point, int *m)
 /* compute polar polyhedron of (tri, n) */
 PFV* TRI_Polarise (TRI *tri, int n, int *m)
 {
-  int pfvcnt; /* number of vertices of all polar faces */
+  return TRI_Polarise_Arena (tri, n, m, NULL);
+}
+
+/* compute polar polyhedron of (tri, n) in arena memory */
+PFV* TRI_Polarise_Arena (TRI *tri, int n, int *m, ARENA *arena)
+{
+  int pfvcnt, vcnt; /* number of vertices of all polar faces and of polar faces */
   PFV *pfv, *p, *q; /* first 'pfcnt' entries are polar face vertex list heads, the rest is list memory of size (pfvcnt - pfcnt); and iterator 'p' */
-  MAP *vm, *im; /* map of visited vertices of (tri, n) (polar faces); iterator 'im' */
-  MEM mem; /* memory for map items */
+  double **ver; /* unique vertices of (tri, n) (polar faces) */
+  TRI **first; /* first triangles around them */
   TRI *t, *s, *e; /* triangle iterators 't' and 's', and table end 'e' */
   double *v, *w, d, x;
   int i, j;
 
-  MEM_Init (&mem, sizeof (MAP), n * 3);
+  ERRMEM (ver = ARENA_Alloc (arena, (sizeof (double*) + sizeof (TRI*)) * 3 * n));
+  first = (TRI**) (ver + 3*n);
+  vcnt = vertex_index (tri, n, ver, first, NULL, arena);
   e = tri + n;
   pfvcnt = 0;
-  vm = NULL;
   pfv = NULL;
 
-  for (t = tri; t < e; t ++) /* for each triangle */
+  for (i = 0; i < vcnt; i ++) /* for each vertex => polar face */
   {
-    for (i = 0; i < 3; i ++) /* for each vertex */
-    {
-      if (! MAP_Find (vm, t->ver [i], NULL)) /* if the vertex was not mapped before */
-      {
-	v = t->ver [i]; /* this is new vertex => new polar face */
-	pfvcnt ++; /* 't' is the first vertex of the new face */
-	
-        for (s = nextaround (t, v), j = 0; s && s != t && j < n; s = nextaround (s, v), j ++) pfvcnt ++; /* add more vertices */
+    v = ver [i];
+    t = first [i];
+    pfvcnt ++; /* 't' is the first vertex of the new face */
+
+    for (s = nextaround (t, v), j = 0; s && s != t && j < n; s = nextaround (s, v), j ++) pfvcnt ++; /* add more vertices */
 
 #if GEOMDEBUG	
-	ASSERT_DEBUG (s && j < n, "Topological inconsistency in the input triangle mesh (a hole was found)"); /* a hole was found */
+    ASSERT_DEBUG (s && j < n, "Topological inconsistency in the input triangle mesh (a hole was found)"); /* a hole was found */
 #else
-	if (!s || j >= n) goto error;
+    if (!s || j >= n) goto error;
 #endif
-
-	MAP_Insert (&mem, &vm, v, t, NULL); /* map vertex 'v' to triangle 't' */
-      }
-    }
   }
 
   /* alloc output memory => PFVs and 'n' vertices */
-  ERRMEM (pfv = malloc (sizeof (PFV) * pfvcnt + sizeof (double [3]) * n));
+  ERRMEM (pfv = ARENA_Alloc (arena, sizeof (PFV) * pfvcnt + sizeof (double [3]) * n));
   w = (double*) (pfv + pfvcnt);
 
   /* compute coordinates */
@@ -415,10 +650,10 @@ PFV* TRI_Polarise (TRI *tri, int n, int *m)
   }
 
   /* now go again and create polar face lists */ 
-  for (i = 0, im = MAP_First (vm); im; im = MAP_Next (im), i ++)
+  for (i = 0; i < vcnt; i ++)
   {
-    v = im->key;
-    t = im->data;
+    v = ver [i];
+    t = first [i];
     pfv [i].coord = w + (t-tri)*3; /* map coord to the memory placed at the end of 'pfv' block */
     pfv [i].nl = v; /* common normal */
     q = &pfv [i]; /* list tail */
@@ -441,12 +676,12 @@ PFV* TRI_Polarise (TRI *tri, int n, int *m)
 #ifndef GEOMDEBUG
 error:
 #endif
-  if (pfv) free (pfv);
+  if (pfv && !arena) free (pfv);
   pfv = NULL;
   i = 0;
 
 done:
-  MEM_Release (&mem);
+  if (!arena) free (ver);
 
   (*m) = i;
   return pfv;
@@ -454,44 +689,26 @@ done:
 
 /* copute vertices */
 double* TRI_Vertices (TRI *tri, int n, int *m)
+{
+  return TRI_Vertices_Arena (tri, n, m, NULL);
+}
+
+/* copute vertices in arena memory */
+double* TRI_Vertices_Arena (TRI *tri, int n, int *m, ARENA *arena)
 {
   int vcnt; /* number of vertices */
-  MAP *vm, *im; /* map of visited vertices; iterator 'im' */
-  MEM mem; /* memory for map items */
-  double *v, *w, *z;
-  TRI *t, *e;
+  double *v, *z, **ver;
   int i;
 
-  MEM_Init (&mem, sizeof (MAP), n * 3);
-  e = tri + n;
-  vm = NULL;
-  vcnt = 0;
-
-  for (t = tri; t < e; t ++)
-  {
-    for (i = 0; i < 3; i ++)
-    {
-      if (! MAP_Find_Node (vm, t->ver [i], NULL)) /* vertex not mapped before */
-      {
-	MAP_Insert (&mem, &vm, t->ver [i], (void*) (long) vcnt, NULL); /* map vertex 'v' to a consecutive index */
-	vcnt ++;
-      }
-    }
-  }
+  ERRMEM (ver = ARENA_Alloc (arena, sizeof (double*) * 3 * n));
+  vcnt = vertex_index (tri, n, ver, NULL, NULL, arena);
 
   /* alloc output memory */
-  ERRMEM (v = malloc (sizeof (double [3]) * vcnt));
+  ERRMEM (v = ARENA_Alloc (arena, sizeof (double [3]) * vcnt));
 
-  /* map old vertices into new placeholders */
-  for (im = MAP_First (vm); im; im = MAP_Next (im), i ++)
-  {
-    w = (double*) im->key; /* vertex source */
-    i = (int) (long) im->data; /* vertex index */
-    z = v + i*3; /* vertex destination */
-    COPY (w, z);
-  }
+  for (i = 0, z = v; i < vcnt; i ++, z += 3) { COPY (ver [i], z); }
 
-  MEM_Release (&mem);
+  if (!arena) free (ver);
 
   *m = vcnt;
   return v;
@@ -499,11 +716,17 @@ double* TRI_Vertices (TRI *tri, int n, int *m)
 
 /* compute planes */
 double* TRI_Planes (TRI *tri, int n, int *m)
+{
+  return TRI_Planes_Arena (tri, n, m, NULL);
+}
+
+/* compute planes in arena memory */
+double* TRI_Planes_Arena (TRI *tri, int n, int *m, ARENA *arena)
 {
   double *v, *w;
   TRI *t, *e;
 
-  ERRMEM (v = malloc (sizeof (double [6]) * n));
+  ERRMEM (v = ARENA_Alloc (arena, sizeof (double [6]) * n));
   e = tri + n;
   
   for (t = tri, w = v; t < e; t ++, w += 6)
@@ -516,6 +739,148 @@ double* TRI_Planes (TRI *tri, int n, int *m)
   return v;
 }
 
+/* allocate mesh of 'nv' vertices and 'nt' triangles in one block */
+TRIMESH* TRI_Meshalloc (int nv, int nt)
+{
+  TRIMESH *mesh;
+
+  ERRMEM (mesh = malloc (sizeof (TRIMESH) + sizeof (double [3]) * (nv + nt) + sizeof (int [7]) * nt));
+  mesh->ver = (double*) (mesh + 1);
+  mesh->nl = mesh->ver + 3*nv;
+  mesh->tri = (int*) (mesh->nl + 3*nt);
+  mesh->adj = mesh->tri + 3*nt;
+  mesh->flg = mesh->adj + 3*nt;
+  mesh->nv = nv;
+  mesh->nt = nt;
+
+  return mesh;
+}
+
+/* convert triangulation into an indexed mesh */
+TRIMESH* TRI_Tomesh (TRI *tri, int n, double *pv, int nv)
+{
+  int i, j, k, *map, *corner;
+  TRIMESH *mesh;
+  double *x, *y, **ver;
+  TRI *t, *e;
+
+  e = tri + n;
+  ver = NULL;
+  map = NULL;
+
+  if (pv) /* vertex indices follow from the table */
+  {
+    ERRMEM (map = malloc (sizeof (int) * nv));
+    for (i = 0; i < nv; i ++) map [i] = -1;
+    for (t = tri, k = 0; t < e; t ++)
+    {
+      for (i = 0; i < 3; i ++)
+      {
+	j = (t->ver [i] - pv) / 3;
+	if (map [j] < 0) map [j] = k ++;
+      }
+    }
+
+    mesh = TRI_Meshalloc (k, n);
+
+    for (j = 0; j < nv; j ++)
+    {
+      if (map [j] >= 0) { x = &pv [3*j]; y = &mesh->ver [3*map[j]]; COPY (x, y); }
+    }
+
+    for (t = tri, j = 0; t < e; t ++)
+    {
+      for (i = 0; i < 3; i ++, j ++) mesh->tri [j] = map [(t->ver [i] - pv) / 3];
+    }
+
+    free (map);
+  }
+  else /* unique vertices need to be found */
+  {
+    ERRMEM (ver = malloc ((sizeof (double*) + sizeof (int)) * 3 * n));
+    corner = (int*) (ver + 3*n);
+    k = vertex_index (tri, n, ver, NULL, corner, NULL);
+
+    mesh = TRI_Meshalloc (k, n);
+
+    for (j = 0; j < k; j ++) { y = &mesh->ver [3*j]; COPY (ver [j], y); }
+    memcpy (mesh->tri, corner, sizeof (int [3]) * n);
+
+    free (ver);
+  }
+
+  for (t = tri, j = 0; t < e; t ++, j ++)
+  {
+    x = &mesh->nl [3*j];
+    COPY (t->out, x);
+    NORMALIZE (x);
+    mesh->flg [j] = t->flg;
+
+    for (i = 0; i < 3; i ++) mesh->adj [3*j+i] = t->adj [i] ? t->adj [i] - tri : -1;
+  }
+
+  return mesh;
+}
+
+/* compute adjacency of an indexed mesh */
+void TRI_Meshadj (TRIMESH *mesh)
+{
+  int i, j, a, b, h, g, *off, *hed, *tri = mesh->tri, nh = 3 * mesh->nt;
+
+  ERRMEM (off = calloc (mesh->nv + 1, sizeof (int)));
+  ERRMEM (hed = malloc (sizeof (int) * nh));
+
+  /* half-edges (tri [h] => tri [next (h)]) grouped by their origins */
+  for (h = 0; h < nh; h ++) off [tri [h] + 1] ++;
+  for (i = 0; i < mesh->nv; i ++) off [i+1] += off [i];
+  for (h = 0; h < nh; h ++) hed [off [tri [h]] ++] = h;
+  for (i = mesh->nv; i > 0; i --) off [i] = off [i-1]; /* restore offsets */
+  off [0] = 0;
+
+  for (h = 0; h < nh; h ++)
+  {
+    a = tri [h];
+    b = tri [h % 3 < 2 ? h + 1 : h - 2];
+    mesh->adj [h] = -1;
+
+    for (j = off [b]; j < off [b+1]; j ++) /* the opposite half-edge starts at 'b' */
+    {
+      g = hed [j];
+      if (tri [g % 3 < 2 ? g + 1 : g - 2] == a) { mesh->adj [h] = g / 3; break; }
+    }
+  }
+
+  free (hed);
+  free (off);
+}
+
+/* convert an indexed mesh into triangles */
+TRI* TRI_Frommesh (TRIMESH *mesh)
+{
+  TRI *out, *t;
+  double *v;
+  int i, j;
+
+  ERRMEM (out = malloc (sizeof (TRI) * mesh->nt + sizeof (double [3]) * mesh->nv));
+  v = (double*) (out + mesh->nt);
+  memcpy (v, mesh->ver, sizeof (double [3]) * mesh->nv);
+
+  for (t = out, j = 0; j < mesh->nt; t ++, j ++)
+  {
+    COPY (&mesh->nl [3*j], t->out);
+    t->flg = mesh->flg [j];
+    t->ptr = NULL;
+
+    for (i = 0; i < 3; i ++)
+    {
+      t->ver [i] = &v [3 * mesh->tri [3*j+i]];
+      t->adj [i] = mesh->adj [3*j+i] >= 0 ? out + mesh->adj [3*j+i] : NULL;
+    }
+  }
+
+  return out;
+}
+
 /* compute mass center and volume of triangulated solid */
 double TRI_Char (TRI *tri, int n, double *center)
 {
@@ -570,6 +935,154 @@ double TRI_Char (TRI *tri, int n, double *center)
   return volume;
 }
 
+/* number of triangles integrated together in the mass kernel */
+#define MASS_LANES 8
+
+/* number of triangles per partial sum of the mass reduction */
+#define MASS_CHUNK 1024
+
+/* integrate triangles [lo, hi) of either (tri) or (mesh) into the ten sums
+ * {J, J sx, J sy, J sz, J E[xx], J E[xy], J E[xz], J E[yy], J E[yz], J E[zz]}
+ * over the tetrahedra spanned by the triangles and the reference point;
+ * triangles are gathered in blocks of MASS_LANES coordinates, so that the
+ * integration loop vectorises, and lanes are summed in a fixed order */
+static void mass_chunk (TRI *tri, TRIMESH *mesh, double *ref, int lo, int hi, double *sum)
+{
+  double g [9][MASS_LANES], acc [10][MASS_LANES], *p;
+  double J, sx, sy, sz;
+  int i, j, k, l;
+
+  for (k = 0; k < 10; k ++)
+    for (l = 0; l < MASS_LANES; l ++) acc [k][l] = 0.0;
+
+  for (j = lo; j < hi; j += MASS_LANES)
+  {
+    for (l = 0; l < MASS_LANES; l ++)
+    {
+      for (i = 0; i < 3; i ++)
+      {
+	if (j + l >= hi) /* zero padding yields J = 0 */
+	{
+	  g [3*i][l] = g [3*i+1][l] = g [3*i+2][l] = 0.0;
+	  continue;
+	}
+
+	p = tri ? tri [j+l].ver [i] : &mesh->ver [3 * mesh->tri [3*(j+l)+i]];
+	g [3*i][l] = p [0] - ref [0];
+	g [3*i+1][l] = p [1] - ref [1];
+	g [3*i+2][l] = p [2] - ref [2];
+      }
+    }
+
+    for (l = 0; l < MASS_LANES; l ++)
+    {
+      /* J = a . (b x c) */
+      J = g[0][l] * (g[4][l]*g[8][l] - g[5][l]*g[7][l]) -
+	  g[1][l] * (g[3][l]*g[8][l] - g[5][l]*g[6][l]) +
+	  g[2][l] * (g[3][l]*g[7][l] - g[4][l]*g[6][l]);
+
+      sx = g[0][l] + g[3][l] + g[6][l];
+      sy = g[1][l] + g[4][l] + g[7][l];
+      sz = g[2][l] + g[5][l] + g[8][l];
+
+      /* with the fourth vertex at zero the simplex_xx..zz
+       * integrands reduce to s s^T + a a^T + b b^T + c c^T */
+      acc [0][l] += J;
+      acc [1][l] += J * sx;
+      acc [2][l] += J * sy;
+      acc [3][l] += J * sz;
+      acc [4][l] += J * (sx*sx + g[0][l]*g[0][l] + g[3][l]*g[3][l] + g[6][l]*g[6][l]);
+      acc [5][l] += J * (sx*sy + g[0][l]*g[1][l] + g[3][l]*g[4][l] + g[6][l]*g[7][l]);
+      acc [6][l] += J * (sx*sz + g[0][l]*g[2][l] + g[3][l]*g[5][l] + g[6][l]*g[8][l]);
+      acc [7][l] += J * (sy*sy + g[1][l]*g[1][l] + g[4][l]*g[4][l] + g[7][l]*g[7][l]);
+      acc [8][l] += J * (sy*sz + g[1][l]*g[2][l] + g[4][l]*g[5][l] + g[7][l]*g[8][l]);
+      acc [9][l] += J * (sz*sz + g[2][l]*g[2][l] + g[5][l]*g[5][l] + g[8][l]*g[8][l]);
+    }
+  }
+
+  for (k = 0; k < 10; k ++)
+    for (sum [k] = 0.0, l = 0; l < MASS_LANES; l ++) sum [k] += acc [k][l];
+}
+
+/* common part of TRI_Mass and TRI_Meshmass */
+static double mass (TRI *tri, TRIMESH *mesh, int n, double *center, double *euler)
+{
+  double ref [3], *sum, *s, tot [10], d [3], volume;
+  int nch, j, k;
+
+  if (n == 0)
+  {
+    if (center) SET (center, 0.0);
+    if (euler) SET9 (euler, 0.0);
+    return 0.0;
+  }
+
+  /* integrating relative to a point on the surface reduces cancellation far from the origin */
+  s = tri ? tri->ver [0] : &mesh->ver [3 * mesh->tri [0]];
+  COPY (s, ref);
+
+  /* partial sums of fixed size chunks are added in the chunk order,
+   * hence the result does not depend on the number of threads */
+  nch = (n + MASS_CHUNK - 1) / MASS_CHUNK;
+  ERRMEM (sum = malloc (sizeof (double [10]) * nch));
+
+#if OPENMP
+  #pragma omp parallel for schedule (static)
+#endif
+  for (j = 0; j < nch; j ++)
+  {
+    mass_chunk (tri, mesh, ref, j * MASS_CHUNK, MIN ((j+1) * MASS_CHUNK, n), &sum [10*j]);
+  }
+
+  for (k = 0; k < 10; k ++) tot [k] = 0.0;
+  for (j = 0, s = sum; j < nch; j ++, s += 10)
+    for (k = 0; k < 10; k ++) tot [k] += s [k];
+
+  free (sum);
+
+  volume = tot [0] / 6.0;
+
+  if (volume > 0.0)
+  {
+    d [0] = tot [1] / (24.0 * volume);
+    d [1] = tot [2] / (24.0 * volume);
+    d [2] = tot [3] / (24.0 * volume);
+  }
+  else
+  {
+    SET (d, 0.0);
+  }
+
+  if (center) ADD (ref, d, center);
+
+  if (euler) /* shift from the reference point to the mass center */
+  {
+    euler [0] = tot [4] / 120.0 - volume * d[0]*d[0];
+    euler [1] = tot [5] / 120.0 - volume * d[0]*d[1];
+    euler [2] = tot [6] / 120.0 - volume * d[0]*d[2];
+    euler [4] = tot [7] / 120.0 - volume * d[1]*d[1];
+    euler [5] = tot [8] / 120.0 - volume * d[1]*d[2];
+    euler [8] = tot [9] / 120.0 - volume * d[2]*d[2];
+    euler [3] = euler [1];
+    euler [6] = euler [2];
+    euler [7] = euler [5];
+  }
+
+  return volume;
+}
+
+/* compute volume, mass center and Euler tensor of triangulated solid in one pass */
+double TRI_Mass (TRI *tri, int n, double *center, double *euler)
+{
+  return mass (tri, NULL, n, center, euler);
+}
+
+/* compute volume, mass center and Euler tensor of an indexed mesh in one pass */
+double TRI_Meshmass (TRIMESH *mesh, double *center, double *euler)
+{
+  return mass (NULL, mesh, mesh->nt, center, euler);
+}
+
 /* create triangulation based kd-tree;
  * nodes store triangle-extents-dropped triangle sets */
 KDT* TRI_Kdtree (TRI *tri, int n)
@@ -27,6 +27,7 @@
  */
 
 #include "kdt.h"
+#include "mem.h"
 
 #ifndef __tri__
 #define __tri__
@@ -50,6 +51,17 @@ struct triangle_surface
   int m; /* number of triangles as outputed by 'cvi' */
 };
 
+typedef struct triangle_mesh TRIMESH; /* indexed triangle mesh */
+struct triangle_mesh
+{
+  double *ver; /* vertices of size (double [3]) x nv */
+  double *nl; /* outward unit normals of size (double [3]) x nt */
+  int *tri; /* CCW vertex indices of size (int [3]) x nt */
+  int *adj; /* adjacent triangle indices (ordered as in TRI) or -1, of size (int [3]) x nt */
+  int *flg; /* flags as in TRI of size nt */
+  int nv, nt;
+};
+
 typedef struct polar_face_vertex PFV; /* vertex of a polar face */
 struct polar_face_vertex
 {
@@ -67,12 +79,25 @@ void TRI_Sortadj (TRI *tri);
 int TRI_Addadj (TRI *p, TRI *q);
 
 /* copy triangles into a continuous memory block;
- * vertices are placed right after the returned table */
+ * vertices are placed right after the returned table,
+ * in the order of their first appearance in (tri, n) */
 TRI* TRI_Copy (TRI *tri, int n);
 
-/* merge two triangulations; adjacency is not maintained */
+/* merge two triangulations, welding vertices closer than GEOMETRIC_EPSILON
+ * (each to the nearest earlier representative) and dropping triangles that
+ * become degenerate; adjacency is not maintained */
 TRI* TRI_Merge (TRI *one, int none, TRI *two, int ntwo, int *m);
 
+/* arena variants of TRI_Copy, TRI_Merge, TRI_Polarise, TRI_Vertices and TRI_Planes:
+ * the output and the scratch memory are allocated from the 'arena', hence the
+ * returned block must not be freed and it remains valid until the arena is reset;
+ * a NULL 'arena' is equivalent to the heap based call */
+TRI* TRI_Copy_Arena (TRI *tri, int n, ARENA *arena);
+TRI* TRI_Merge_Arena (TRI *one, int none, TRI *two, int ntwo, int *m, ARENA *arena);
+PFV* TRI_Polarise_Arena (TRI *tri, int n, int *m, ARENA *arena);
+double* TRI_Vertices_Arena (TRI *tri, int n, int *m, ARENA *arena);
+double* TRI_Planes_Arena (TRI *tri, int n, int *m, ARENA *arena);
+
 /* compute adjacency structure */
 void TRI_Compadj (TRI *tri, int n);
 
@@ -86,11 +111,14 @@ TRI* TRI_Topoadj (TRI *tri, int n, double *point, int *m);
 /* input => convex polyhedron containing zero (tri, n);
  * output => polar polyhedron defined by 'm' vertex lists;
  * a continuous block of memory is returned; 'nl's point to 'ver'
- * members in 'tri'; 'coord's point within the returned block */
+ * members in 'tri'; 'coord's point within the returned block;
+ * the polar faces follow the first appearance of their dual
+ * vertices in (tri, n) */
 PFV* TRI_Polarise (TRI *tri, int n, int *m);
 
 /* extract vertices of triangulation (tri, n)
- * into a table of size (double [3]) x m */
+ * into a table of size (double [3]) x m,
+ * in the order of their first appearance */
 double* TRI_Vertices (TRI *tri, int n, int *m);
 
 /* extract planes of triangulation (tri, n)
@@ -98,9 +126,36 @@ double* TRI_Vertices (TRI *tri, int n, int *m);
  * each plane is represented by (normal, point) */
 double* TRI_Planes (TRI *tri, int n, int *m);
 
+/* convert triangulation (tri, n) into an indexed mesh; if 'pv' is not NULL then all vertices
+ * point into the (pv, nv) table, which saves searching them, and only the referenced ones are
+ * copied; the adjacency is copied (NULL pointers becoming -1); the returned mesh arrays are
+ * placed in one continuous block following the mesh structure, hence the block is relocatable
+ * after the array pointers are rebased, and it should be freed by the caller */
+TRIMESH* TRI_Tomesh (TRI *tri, int n, double *pv, int nv);
+
+/* allocate an indexed mesh of 'nv' vertices and 'nt' triangles, with its arrays placed in one
+ * continuous block following the mesh structure (as in TRI_Tomesh); the arrays are not set */
+TRIMESH* TRI_Meshalloc (int nv, int nt);
+
+/* compute the adjacency of an indexed mesh from its vertex indices */
+void TRI_Meshadj (TRIMESH *mesh);
+
+/* convert an indexed mesh into a table of 'nt' triangles followed by the vertices,
+ * in the format of TRI_Copy (the 'ptr' members are set to NULL) */
+TRI* TRI_Frommesh (TRIMESH *mesh);
+
 /* compute mass center and volume of triangulated solid */
 double TRI_Char (TRI *tri, int n, double *center);
 
+/* compute volume, mass center and Euler tensor of triangulated solid in one pass;
+ * euler [9] (column-major) is the integral of (x - center) (x - center)^T over the
+ * volume, hence the inertia tensor is trace (euler) I - euler (per unit density);
+ * 'center' and 'euler' can be NULL; the summation order does not depend on threading */
+double TRI_Mass (TRI *tri, int n, double *center, double *euler);
+
+/* compute volume, mass center and Euler tensor of an indexed mesh as in TRI_Mass */
+double TRI_Meshmass (TRIMESH *mesh, double *center, double *euler);
+
 /* create triangulation based kd-tree;
  * nodes store triangle-extents-dropped triangle sets */
 KDT* TRI_Kdtree (TRI *tri, int n);